@@ -0,0 +1,761 @@
+/* emu.c
+   Register file, SPI2, I2C1, port pins, interrupts and time for the
+   host emulator. See pic32mx.h for how register accesses get here and
+   emu.h for what the rest of the host build can use.
+
+   For copyright and licensing, see file COPYING */
+
+#include <stdio.h>
+#include <string.h>
+#include "pic32mx.h"
+#include "emu.h"
+
+/* SPI2CON bits */
+#define CON_MSTEN 0x20
+#define CON_MODE16 0x400
+#define CON_MODE32 0x800
+#define CON_ON 0x8000
+#define CON_ENHBUF 0x10000
+#define CON_STXISEL(con) (((con) >> 2) & 3)
+
+/* SPI2CON bits that may only change while SPI2 is off */
+#define CON_SETUP (CON_MSTEN | CON_MODE16 | CON_MODE32 | CON_ENHBUF)
+
+/* SPI2STAT bits, with the enhanced buffer */
+#define STAT_RBF 0x01
+#define STAT_TBF 0x02
+#define STAT_TBE 0x08
+#define STAT_RBE 0x20
+#define STAT_ROV 0x40
+#define STAT_SRMT 0x80
+#define STAT_BUSY 0x800
+
+/* I2C1CON bits */
+#define I2C_SEN 0x01
+#define I2C_RSEN 0x02
+#define I2C_PEN 0x04
+#define I2C_RCEN 0x08
+#define I2C_ACKEN 0x10
+#define I2C_ACKDT 0x20
+#define I2C_ON 0x8000
+
+/* I2C1CON bits that start a bus event */
+#define I2C_EVENTS (I2C_SEN | I2C_RSEN | I2C_PEN | I2C_RCEN | I2C_ACKEN)
+
+/* I2C1STAT bits */
+#define I2C_TBF 0x01
+#define I2C_RBF 0x02
+#define I2C_S 0x08
+#define I2C_P 0x10
+#define I2C_OV 0x40
+#define I2C_IWCOL 0x80
+#define I2C_BCL 0x400
+#define I2C_TRSTAT 0x4000
+#define I2C_ACKSTAT 0x8000
+
+/* I2C1STAT bits software can clear */
+#define I2C_STAT_CLEARABLE (I2C_OV | I2C_IWCOL | I2C_BCL)
+
+/* Ticks of one SCL period: 2 * (I2C1BRG + 2) peripheral clocks and
+   twice the 104 ns pulse gobbler delay, about 8 ticks */
+#define I2C_BIT_TICKS(brg) ((brg) + 2 + 8)
+
+/* Display pins on the Basic I/O Shield; all but D/C are active low */
+#define PIN_DC 0x10    /* PORTF */
+#define PIN_VBAT 0x20  /* PORTF */
+#define PIN_VDD 0x40   /* PORTF */
+#define PIN_RESET 0x200 /* PORTG */
+
+/* I2C1 lines, and the sensor's ALERT output, which is also INT1 */
+#define PIN_SCL 0x04    /* PORTG */
+#define PIN_SDA 0x08    /* PORTG */
+#define PIN_ALERT 0x100 /* PORTD */
+
+/* Interrupt flags: SPI2 TX in IFS1, the I2C1 master and INT1 in
+   IFS0, and the INT1 edge in INTCON */
+#define IRQ_SPI2TX (1 << 6)
+#define IRQ_I2C1M (1u << 31)
+#define IRQ_INT1 (1 << 7)
+#define INTCON_INT1EP 0x02
+
+/* Longest emu_wait goes between looking at the sensors, which may
+   finish a conversion or change their alert at any time */
+#define WAIT_STEP_TICKS (100 * EMU_TICKS_PER_US)
+
+/* Ticks a register access or a core timer read takes, roughly what
+   a load or store over the peripheral bus costs */
+#define ACCESS_TICKS 1
+
+/* The deepest SPI2 FIFO: 16 bytes with the enhanced buffer */
+#define FIFO_MAX 16
+
+/* Accesses whose slots may still be read: one expression can
+   read several registers before it looks at any of the values */
+#define SLOTS 8
+
+struct emu_count emu_count;
+unsigned int emu_faults;
+
+/* Register values; for ports, what the latch holds */
+static unsigned int regs[EMU_REG_COUNT] = {
+    [EMU_TRISD] = 0xFFFF,
+    [EMU_TRISE] = 0xFFFF,
+    [EMU_TRISF] = 0xFFFF,
+    [EMU_TRISG] = 0xFFFF,
+};
+
+/* Levels on the PORTD input pins */
+static unsigned int inputs;
+
+/* Time in core timer ticks */
+static unsigned long long now;
+
+/* The access made by the last emu_reg call, acted on by commit */
+static volatile unsigned int slot[SLOTS];
+static int slot_next;
+static int pend_slot = -1;
+static int pend_id, pend_op;
+static unsigned int pend_value;
+
+/* SPI2: the transmit FIFO, the word in the shift register and when
+   its last bit goes out, and the receive FIFO */
+static unsigned int tx_fifo[FIFO_MAX];
+static int tx_head, tx_count;
+static unsigned int shift_word;
+static int shifting;
+static unsigned long long shift_end;
+static unsigned int rx_fifo[FIFO_MAX];
+static int rx_head, rx_count;
+
+/* The SSD1306 leaves MISO alone, so what SPI2 receives is noise */
+static unsigned int noise = 0x2545F491;
+
+/* Level of the D/C line */
+static int dc_pin = 1;
+
+/* I2C1: the bus event under way, what it sends, and when it is done */
+#define I2C_IDLE 0
+#define I2C_START 1
+#define I2C_RESTART 2
+#define I2C_STOP 3
+#define I2C_WRITE 4
+#define I2C_READ 5
+#define I2C_ACK 6
+static int i2c_event;
+static unsigned int i2c_byte;
+static unsigned long long i2c_end;
+
+/* Levels of SCL as the port drives it, and of ALERT */
+static int scl_pin = 1;
+static int alert_pin = 1;
+
+/* Interrupts: the handler, the IE bit of CP0 Status, and whether the
+   handler is running */
+static void (*isr_handler)(void);
+static int irq_enabled;
+static int in_isr;
+
+static void tick(unsigned int ticks);
+
+/* emu_fault:
+   Report a broken rule and count it. */
+void emu_fault(const char *what)
+{
+  fprintf(stderr, "emu: %s at %llu us\n", what, now / EMU_TICKS_PER_US);
+  emu_faults++;
+}
+
+static int spi_depth(void)
+{
+  unsigned int con = regs[EMU_SPI2CON];
+
+  if (!(con & CON_ENHBUF))
+    return 1;
+  return con & CON_MODE32 ? 4 : con & CON_MODE16 ? 8 : 16;
+}
+
+static int spi_bits(void)
+{
+  unsigned int con = regs[EMU_SPI2CON];
+
+  return con & CON_MODE32 ? 32 : con & CON_MODE16 ? 16 : 8;
+}
+
+/* A received word. In 8- and 16-bit mode the unused upper bits are
+   set, so that no value the code writes can look like the value read
+   back, which is how commit tells a write from a read. */
+static unsigned int spi_noise(void)
+{
+  noise = noise * 1103515245 + 12345;
+  if (spi_bits() == 32)
+    return noise;
+  return noise | (spi_bits() == 16 ? 0xFFFF0000 : 0xFFFFFF00);
+}
+
+static unsigned int spi_status(void)
+{
+  unsigned int v = regs[EMU_SPI2STAT] & STAT_ROV;
+  int depth = spi_depth();
+
+  if (tx_count == depth)
+    v |= STAT_TBF;
+  if (tx_count == 0)
+    v |= STAT_TBE;
+  if (tx_count == 0 && !shifting)
+    v |= STAT_SRMT;
+  if (tx_count > 0 || shifting)
+    v |= STAT_BUSY;
+  if (rx_count == 0)
+    v |= STAT_RBE;
+  if (rx_count == depth)
+    v |= STAT_RBF;
+  return v;
+}
+
+/* Move the next word from the TX FIFO to the shift register at time t.
+   Each bit takes 2 * (SPI2BRG + 1) cycles of the 80 MHz peripheral
+   clock, which is SPI2BRG + 1 core timer ticks. */
+static void spi_load(unsigned long long t)
+{
+  unsigned int ticks;
+
+  if (shifting || tx_count == 0)
+    return;
+  shift_word = tx_fifo[tx_head];
+  tx_head = (tx_head + 1) % FIFO_MAX;
+  tx_count--;
+  ticks = spi_bits() * ((regs[EMU_SPI2BRG] & 0x1FF) + 1);
+  shifting = 1;
+  shift_end = t + ticks;
+  emu_count.busy_ticks += ticks;
+}
+
+/* Hand the word that has left the shift register to the display,
+   most significant byte first, and receive one in its place */
+static void spi_done(void)
+{
+  int bits = spi_bits(), i;
+
+  if (bits == 32)
+    emu_count.words32++;
+  for (i = bits - 8; i >= 0; i -= 8)
+  {
+    if (dc_pin)
+      emu_count.data_bytes++;
+    else
+      emu_count.cmd_bytes++;
+    ssd1306_byte(dc_pin, (shift_word >> i) & 0xFF, (unsigned int)now);
+  }
+  shifting = 0;
+
+  if (rx_count == spi_depth())
+    regs[EMU_SPI2STAT] |= STAT_ROV;
+  else
+    rx_fifo[(rx_head + rx_count++) % FIFO_MAX] = spi_noise();
+}
+
+/* Run SPI2 up to the current time, and raise the TX interrupt flag
+   while the TX FIFO is as empty as STXISEL asks for */
+static void spi_run(void)
+{
+  unsigned long long t;
+  int depth, raise;
+
+  while (shifting && shift_end <= now)
+  {
+    t = shift_end;
+    spi_done();
+    spi_load(t);
+  }
+
+  if (!(regs[EMU_SPI2CON] & CON_ON))
+    return;
+  depth = spi_depth();
+  switch (CON_STXISEL(regs[EMU_SPI2CON]))
+  {
+  case 0:
+    raise = tx_count == 0 && !shifting;
+    break;
+  case 1:
+    raise = tx_count == 0;
+    break;
+  case 2:
+    raise = tx_count <= depth / 2;
+    break;
+  default:
+    raise = tx_count < depth;
+    break;
+  }
+  if (raise)
+    regs[EMU_IFS0 + 1] |= IRQ_SPI2TX;
+}
+
+static void spi_write(unsigned int v)
+{
+  if (!(regs[EMU_SPI2CON] & CON_ON) || !(regs[EMU_SPI2CON] & CON_MSTEN))
+  {
+    emu_fault("SPI2BUF written while SPI2 is not an enabled master");
+    return;
+  }
+  if (tx_count == spi_depth())
+  {
+    emu_fault("SPI2BUF written with the TX FIFO full");
+    return;
+  }
+  if (spi_bits() < 32)
+    v &= (1u << spi_bits()) - 1;
+  tx_fifo[(tx_head + tx_count++) % FIFO_MAX] = v;
+  spi_load(now);
+}
+
+static void spi_read(void)
+{
+  if (rx_count == 0)
+    return;
+  rx_head = (rx_head + 1) % FIFO_MAX;
+  rx_count--;
+}
+
+static void spi_control(unsigned int con)
+{
+  unsigned int old = regs[EMU_SPI2CON];
+
+  if ((old & con & CON_ON) && ((old ^ con) & CON_SETUP))
+    emu_fault("SPI2CON mode changed while SPI2 is on");
+  if ((old & CON_ON) && !(con & CON_ON))
+  {
+    if (shifting || tx_count > 0)
+      emu_fault("SPI2 turned off while sending");
+    /* Turning SPI2 off empties it */
+    shifting = 0;
+    tx_count = rx_count = 0;
+    regs[EMU_SPI2STAT] &= ~STAT_ROV;
+  }
+  regs[EMU_SPI2CON] = con;
+}
+
+/* Start a bus event that takes bits SCL periods */
+static void i2c_begin(int event, int bits)
+{
+  unsigned int ticks = bits * I2C_BIT_TICKS(regs[EMU_I2C1BRG] & 0xFFF);
+
+  i2c_event = event;
+  i2c_end = now + ticks;
+  emu_count.i2c_ticks += ticks;
+}
+
+/* Finish the bus event under way once its time is up, unless a
+   sensor holds SCL, and raise the master interrupt flag */
+static void i2c_run(void)
+{
+  unsigned int *con = &regs[EMU_I2C1CON], *stat = &regs[EMU_I2C1STAT];
+
+  tcn75a_run((unsigned int)now);
+  if (i2c_event == I2C_IDLE || now < i2c_end || tcn75a_holding_scl())
+    return;
+
+  switch (i2c_event)
+  {
+  case I2C_START:
+  case I2C_RESTART:
+    *con &= ~(I2C_SEN | I2C_RSEN);
+    if (tcn75a_holding_sda())
+    {
+      /* SDA is low where the start should pull it down */
+      *stat |= I2C_BCL;
+      break;
+    }
+    *stat = (*stat & ~I2C_P) | I2C_S;
+    emu_count.i2c_starts++;
+    tcn75a_start();
+    break;
+
+  case I2C_STOP:
+    *con &= ~I2C_PEN;
+    *stat = (*stat & ~I2C_S) | I2C_P;
+    tcn75a_stop();
+    break;
+
+  case I2C_WRITE:
+    *stat &= ~(I2C_TBF | I2C_TRSTAT | I2C_ACKSTAT);
+    if (!tcn75a_write(i2c_byte, (unsigned int)now))
+      *stat |= I2C_ACKSTAT;
+    emu_count.i2c_bytes++;
+    break;
+
+  case I2C_READ:
+    *con &= ~I2C_RCEN;
+    if (*stat & I2C_RBF)
+      *stat |= I2C_OV;
+    regs[EMU_I2C1RCV] = tcn75a_read();
+    *stat |= I2C_RBF;
+    emu_count.i2c_bytes++;
+    break;
+
+  case I2C_ACK:
+    *con &= ~I2C_ACKEN;
+    tcn75a_ack(!(*con & I2C_ACKDT));
+    break;
+  }
+  i2c_event = I2C_IDLE;
+  regs[EMU_IFS0] |= IRQ_I2C1M;
+}
+
+static void i2c_control(unsigned int con)
+{
+  unsigned int old = regs[EMU_I2C1CON];
+  unsigned int set = con & ~old & I2C_EVENTS;
+
+  if ((old & I2C_ON) && !(con & I2C_ON))
+  {
+    /* Turning I2C1 off drops whatever it was doing on the bus */
+    i2c_event = I2C_IDLE;
+    con &= ~I2C_EVENTS;
+    regs[EMU_I2C1STAT] &= ~(I2C_TBF | I2C_TRSTAT | I2C_S);
+  }
+  regs[EMU_I2C1CON] = con;
+  if (!set)
+    return;
+
+  if (!(con & I2C_ON))
+    emu_fault("I2C1CON bus event started while I2C1 is off");
+  else if (set & (set - 1))
+    emu_fault("I2C1CON more than one bus event started at once");
+  else if (i2c_event != I2C_IDLE)
+    emu_fault("I2C1CON bus event started while the last one is on the bus");
+  else
+  {
+    switch (set)
+    {
+    case I2C_SEN:
+      i2c_begin(I2C_START, 1);
+      break;
+    case I2C_RSEN:
+      i2c_begin(I2C_RESTART, 1);
+      break;
+    case I2C_PEN:
+      i2c_begin(I2C_STOP, 1);
+      break;
+    case I2C_RCEN:
+      i2c_begin(I2C_READ, 8);
+      break;
+    default:
+      i2c_begin(I2C_ACK, 1);
+      break;
+    }
+    return;
+  }
+  regs[EMU_I2C1CON] &= ~set;
+}
+
+static void i2c_transmit(unsigned int v)
+{
+  if (!(regs[EMU_I2C1CON] & I2C_ON))
+  {
+    emu_fault("I2C1TRN written while I2C1 is off");
+    return;
+  }
+  if (i2c_event != I2C_IDLE)
+  {
+    regs[EMU_I2C1STAT] |= I2C_IWCOL;
+    emu_fault("I2C1TRN written while the bus is busy");
+    return;
+  }
+  i2c_byte = v & 0xFF;
+  regs[EMU_I2C1STAT] |= I2C_TBF | I2C_TRSTAT;
+  i2c_begin(I2C_WRITE, 9);
+}
+
+/* INT1 flag on the edge of ALERT that INTCON selects */
+static void int1_run(void)
+{
+  int level = tcn75a_alert_pin();
+
+  if (level == alert_pin)
+    return;
+  alert_pin = level;
+  if (level == ((regs[EMU_INTCON] & INTCON_INT1EP) != 0))
+    regs[EMU_IFS0] |= IRQ_INT1;
+}
+
+/* A pin reads as its latch when it is an output, else as pulled up */
+static unsigned int pins(int port, int tris)
+{
+  return regs[port] | regs[tris];
+}
+
+/* Pass the display pins on after a port or direction change */
+static void pins_changed(void)
+{
+  unsigned int f = pins(EMU_PORTF, EMU_TRISF);
+  unsigned int g = pins(EMU_PORTG, EMU_TRISG);
+  int dc = (f & PIN_DC) != 0;
+
+  if (dc != dc_pin)
+  {
+    if (shifting || tx_count > 0)
+      emu_fault("D/C changed while SPI2 was sending");
+    dc_pin = dc;
+    emu_count.dc_toggles++;
+  }
+  ssd1306_pins(!(f & PIN_VDD), !(f & PIN_VBAT), !(g & PIN_RESET), (unsigned int)now);
+
+  /* With I2C1 off, SCL is a port pin, and i2c_recover clocks it */
+  if (!(regs[EMU_I2C1CON] & I2C_ON))
+  {
+    if ((g & PIN_SCL) && !scl_pin)
+    {
+      emu_count.i2c_clocks++;
+      tcn75a_clock();
+    }
+    scl_pin = (g & PIN_SCL) != 0;
+  }
+}
+
+/* The value an access to register id reads */
+static unsigned int reg_read(int id)
+{
+  unsigned int v;
+
+  switch (id)
+  {
+  case EMU_SPI2STAT:
+    return spi_status();
+  case EMU_SPI2BUF:
+    return rx_count > 0 ? rx_fifo[rx_head] : spi_noise();
+  case EMU_PORTD:
+    v = (inputs & ~PIN_ALERT) | (tcn75a_alert_pin() ? PIN_ALERT : 0);
+    return (regs[EMU_PORTD] & ~regs[EMU_TRISD]) | (v & regs[EMU_TRISD]);
+  case EMU_PORTG:
+    /* The sensors pull the I2C lines low over whatever drives them */
+    v = pins(EMU_PORTG, EMU_TRISG);
+    if (tcn75a_holding_scl())
+      v &= ~PIN_SCL;
+    if (tcn75a_holding_sda())
+      v &= ~PIN_SDA;
+    return v;
+  case EMU_I2C1TRN:
+    /* Reads with the upper bits set, so that a byte written that is
+       the same as the last one is still seen as a write */
+    return regs[id] | ~0xFFu;
+  }
+  return regs[id];
+}
+
+static void reg_write(int id, unsigned int v)
+{
+  switch (id)
+  {
+  case EMU_SPI2CON:
+    spi_control(v);
+    break;
+  case EMU_SPI2STAT:
+    /* Only the overflow flag can be written, and only cleared */
+    if (!(v & STAT_ROV))
+      regs[id] &= ~STAT_ROV;
+    break;
+  case EMU_SPI2BUF:
+    spi_write(v);
+    break;
+  case EMU_I2C1CON:
+    i2c_control(v);
+    break;
+  case EMU_I2C1STAT:
+    /* Only the error flags can be written, and only cleared */
+    regs[id] &= ~I2C_STAT_CLEARABLE | v;
+    break;
+  case EMU_I2C1TRN:
+    i2c_transmit(v);
+    break;
+  case EMU_I2C1RCV:
+    emu_fault("I2C1RCV written");
+    break;
+  case EMU_PORTF:
+  case EMU_TRISF:
+  case EMU_PORTG:
+  case EMU_TRISG:
+    regs[id] = v;
+    pins_changed();
+    break;
+  default:
+    regs[id] = v;
+    break;
+  }
+}
+
+/* Act on the access made through the last slot handed out */
+static void commit(void)
+{
+  unsigned int v, old;
+  int id = pend_id;
+
+  if (pend_slot < 0)
+    return;
+  v = slot[pend_slot];
+  pend_slot = -1;
+
+  if (pend_op == EMU_OP_PLAIN)
+  {
+    if (v != pend_value)
+      reg_write(id, v);
+    else if (id == EMU_SPI2BUF)
+      spi_read();
+    else if (id == EMU_I2C1RCV)
+      regs[EMU_I2C1STAT] &= ~I2C_RBF;
+    return;
+  }
+
+  /* The CLR, SET and INV addresses read as zero, so any bit set in
+     the slot was written */
+  if (v == 0)
+    return;
+  old = regs[id];
+  if (id == EMU_SPI2STAT)
+    old = spi_status();
+  switch (pend_op)
+  {
+  case EMU_OP_CLR:
+    reg_write(id, old & ~v);
+    break;
+  case EMU_OP_SET:
+    reg_write(id, old | v);
+    break;
+  default:
+    reg_write(id, old ^ v);
+    break;
+  }
+}
+
+/* Run the interrupt handler while interrupts are on and an enabled
+   flag is up. Whatever the handler's last access was, it is done by
+   the time the handler returns. */
+static void irq_check(void)
+{
+  int i, pending;
+
+  while (irq_enabled && !in_isr && isr_handler)
+  {
+    for (pending = 0, i = 0; i < 3; i++)
+      pending |= regs[EMU_IFS0 + i] & regs[EMU_IEC0 + i];
+    if (!pending)
+      return;
+    in_isr = 1;
+    isr_handler();
+    commit();
+    in_isr = 0;
+  }
+}
+
+/* Let ticks pass */
+static void tick(unsigned int ticks)
+{
+  now += ticks;
+  spi_run();
+  i2c_run();
+  int1_run();
+  irq_check();
+}
+
+/* emu_reg:
+   Finish the previous register access, then start one of type op
+   on register id and return the slot to go through. */
+volatile unsigned int *emu_reg(int id, int op)
+{
+  commit();
+  tick(ACCESS_TICKS);
+
+  slot_next = (slot_next + 1) % SLOTS;
+  pend_slot = slot_next;
+  pend_id = id;
+  pend_op = op;
+  pend_value = op == EMU_OP_PLAIN ? reg_read(id) : 0;
+  slot[pend_slot] = pend_value;
+  return &slot[pend_slot];
+}
+
+/* core_timer:
+   Stands in for the one in labwork.S */
+unsigned int core_timer(void)
+{
+  commit();
+  tick(ACCESS_TICKS);
+  return (unsigned int)now;
+}
+
+/* disable_interrupt, restore_interrupt, enable_interrupt:
+   Stand in for the ones in labwork.S. Bit 0 of the status is IE. */
+unsigned int disable_interrupt(void)
+{
+  unsigned int status = irq_enabled;
+
+  commit();
+  irq_enabled = 0;
+  return status;
+}
+
+void restore_interrupt(unsigned int status)
+{
+  commit();
+  irq_enabled = status & 1;
+  irq_check();
+}
+
+void enable_interrupt(void)
+{
+  restore_interrupt(1);
+}
+
+/* emu_count_reset:
+   Start counting the traffic to the display from zero. */
+void emu_count_reset(void)
+{
+  commit();
+  memset(&emu_count, 0, sizeof(emu_count));
+}
+
+/* emu_now:
+   The time in core timer ticks, as core_timer would read it. */
+unsigned int emu_now(void)
+{
+  commit();
+  return (unsigned int)now;
+}
+
+/* emu_wait:
+   Let us microseconds pass, as code that does not touch the hardware
+   would. SPI2 and I2C1 keep sending, the sensors keep converting and
+   interrupts are taken meanwhile. Host code has to wait with this,
+   not in a loop on a variable, for an interrupt handler to get a
+   chance to run. */
+void emu_wait(unsigned int us)
+{
+  unsigned long long end;
+  unsigned long long t;
+
+  commit();
+  end = now + (unsigned long long)us * EMU_TICKS_PER_US;
+  while (now < end)
+  {
+    t = now + WAIT_STEP_TICKS < end ? now + WAIT_STEP_TICKS : end;
+    if (shifting && shift_end < t)
+      t = shift_end;
+    if (i2c_event != I2C_IDLE && i2c_end < t)
+      t = i2c_end;
+    tick(t > now ? (unsigned int)(t - now) : ACCESS_TICKS);
+  }
+}
+
+/* emu_set_isr:
+   The function to run for an interrupt, like user_isr on the board. */
+void emu_set_isr(void (*isr)(void))
+{
+  isr_handler = isr;
+}
+
+/* emu_set_inputs:
+   Levels on the PORTD pins, where the switches and buttons are. RD8
+   is the sensor's ALERT, whatever is set here. */
+void emu_set_inputs(unsigned int portd)
+{
+  inputs = portd;
+}
@@ -0,0 +1,67 @@
+/* emu.h
+   Host emulator of the parts of the chipKIT Uno32 and Basic I/O
+   Shield that the display and sensor code drive: SPI2 with its
+   FIFOs, the I2C1 master, the port pins, INT1, the interrupt flags
+   and the core timer in emu.c, the SSD1306 controller and panel in
+   ssd1306.c, and TCN75A sensors on I2C1 in tcn75a.c.
+
+   Time is simulated. It runs on in core timer ticks as the code
+   touches registers or reads the core timer, and bytes leave SPI2
+   and I2C1 at the rates SPI2BRG and I2C1BRG set, so code that waits
+   for the hardware sees it take as long as it would on the board.
+
+   For copyright and licensing, see file COPYING */
+
+/* Core timer ticks per microsecond, half the 80 MHz system clock */
+#define EMU_TICKS_PER_US 40
+
+/* Traffic to the display and on I2C1 since emu_count_reset */
+struct emu_count
+{
+  unsigned int cmd_bytes;  /* Bytes taken with D/C low */
+  unsigned int data_bytes; /* Bytes taken with D/C high */
+  unsigned int dc_toggles; /* Changes of the D/C line */
+  unsigned int words32;    /* SPI transfers made in 32-bit mode */
+  unsigned int busy_ticks; /* Time the SPI shift register was busy */
+  unsigned int i2c_starts; /* Starts and repeated starts */
+  unsigned int i2c_bytes;  /* Bytes on I2C1, addresses included */
+  unsigned int i2c_ticks;  /* Time I2C1 was busy */
+  unsigned int i2c_clocks; /* SCL pulses made by hand with I2C1 off */
+};
+
+extern struct emu_count emu_count;
+
+/* Broken rules, such as a byte sent too soon after reset or D/C
+   moved while SPI2 was still shifting. Each is also reported on
+   stderr. */
+extern unsigned int emu_faults;
+
+void emu_fault(const char *what);
+void emu_count_reset(void);
+unsigned int emu_now(void);
+void emu_wait(unsigned int us);
+void emu_set_isr(void (*isr)(void));
+void emu_set_inputs(unsigned int portd);
+
+/* The SSD1306 model, fed by emu.c with the time in ticks */
+void ssd1306_pins(int vdd, int vbat, int reset, unsigned int now);
+void ssd1306_byte(int dc, unsigned int byte, unsigned int now);
+int ssd1306_pixel(int x, int y);
+int ssd1306_write_pbm(const char *name);
+
+/* The TCN75A model, fed by emu.c with bus events and the time */
+int tcn75a_command(const char *line);
+int tcn75a_load(const char *name);
+unsigned int tcn75a_script_end(void);
+void tcn75a_run(unsigned int now);
+int tcn75a_holding_scl(void);
+int tcn75a_holding_sda(void);
+void tcn75a_clock(void);
+void tcn75a_start(void);
+void tcn75a_stop(void);
+int tcn75a_write(unsigned int byte, unsigned int now);
+unsigned int tcn75a_read(void);
+void tcn75a_ack(int ack);
+int tcn75a_alert_pin(void);
+int tcn75a_reg(int addr);
+int tcn75a_conf(int addr);
@@ -0,0 +1,469 @@
+/* main.c
+   Host driver for the display and sensor code. Runs mipslabfunc.c
+   and the drawing modules against the emulator, one display job per
+   step, and prints what each cost on the SPI bus: command bytes,
+   data bytes, D/C toggles, 32-bit transfers and the simulated time.
+   Then it runs mipslabi2c.c against modelled TCN75A sensors the same
+   way, printing starts, bytes, hand-made SCL clocks and time on
+   I2C1 for each step.
+
+   After every display step the panel is compared with framebuffer,
+   and every sensor step checks what the driver read against the
+   model. With -o dir, what the panel shows is also written to dir as
+   a PBM. With -s script, the sensors then follow the script while
+   the main one is sampled, and each reading is printed. The exit
+   status is 1 if the panel ever differed from framebuffer, a sensor
+   step failed, or the emulator saw a fault.
+
+   For copyright and licensing, see file COPYING */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pic32mx.h>
+#include "mipslab.h"
+#include "emu.h"
+
+static const char *out_dir;
+static const char *script;
+static int steps;
+static int mismatches;
+static int failures;
+static int format_errors;
+
+/* Same dispatch as user_isr in mipslabmain.c */
+static void host_isr(void)
+{
+  if (IEC(1) & IFS(1) & (1 << 6))
+    display_isr();
+  if (IEC(0) & IFS(0) & (1u << 31))
+    i2c_isr();
+  if (IEC(0) & IFS(0) & 0x80)
+    temp_alert_isr();
+}
+
+/* Ports and SPI2 as main in mipslabmain.c sets them up */
+static void host_setup(void)
+{
+  PORTF = 0xFFFF;
+  PORTG = (1 << 9);
+  TRISFCLR = 0x70;
+  TRISGCLR = 0x200;
+  TRISDSET = (1 << 8);
+
+  SPI2CON = 0;
+  SPI2BRG = 4;
+  SPI2CONSET = 1 << 16;
+  SPI2CONSET = 0x4;
+  SPI2STATCLR = 0x40;
+  SPI2CONSET = 0x40;
+  SPI2CONSET = 0x20;
+  SPI2CONSET = 0x8000;
+
+  emu_set_isr(host_isr);
+}
+
+/* Number of pixels where the panel differs from framebuffer */
+static int panel_diff(void)
+{
+  int x, y, n = 0;
+
+  for (y = 0; y < 32; y++)
+    for (x = 0; x < 128; x++)
+      if (ssd1306_pixel(x, y) != ((framebuffer[y / 8][x] >> (y % 8)) & 1))
+        n++;
+  return n;
+}
+
+/* Start a step: count from zero and note the time */
+static unsigned int step_begin(void)
+{
+  emu_count_reset();
+  return emu_now();
+}
+
+/* End a step: print its traffic, check and save the panel */
+static void step_end(const char *name, unsigned int t0, int check)
+{
+  unsigned int ticks = emu_now() - t0;
+  char path[256];
+  int diff = check ? panel_diff() : 0;
+
+  printf("%-14s %6u %6u %4u %4u %8u %8u%s\n", name,
+         emu_count.cmd_bytes, emu_count.data_bytes, emu_count.dc_toggles,
+         emu_count.words32, emu_count.busy_ticks / EMU_TICKS_PER_US,
+         ticks / EMU_TICKS_PER_US, diff ? "  panel differs" : "");
+  if (diff)
+    mismatches++;
+
+  steps++;
+  if (out_dir)
+  {
+    sprintf(path, "%s/%02d-%s.pbm", out_dir, steps, name);
+    if (!ssd1306_write_pbm(path))
+    {
+      perror(path);
+      exit(2);
+    }
+  }
+}
+
+/* End a sensor step: print its I2C traffic, and count it as failed
+   unless ok */
+static void i2c_step_end(const char *name, unsigned int t0, int ok)
+{
+  unsigned int ticks = emu_now() - t0;
+
+  printf("%-14s %6u %6u %4u %8u %8u%s\n", name, emu_count.i2c_starts,
+         emu_count.i2c_bytes, emu_count.i2c_clocks,
+         emu_count.i2c_ticks / EMU_TICKS_PER_US, ticks / EMU_TICKS_PER_US,
+         ok ? "" : "  failed");
+  if (!ok)
+    failures++;
+}
+
+/* Take a sample of the main sensor as sensorWait in mipslabmain.c
+   does, waiting with emu_wait so the I2C interrupt gets to run.
+   Returns what temp_sample_poll ended with. */
+static int sample(int16_t *temp)
+{
+  int done;
+
+  if (!temp_sample_begin())
+    return -1;
+  while ((done = temp_sample_poll(temp)) == 0)
+    emu_wait(10);
+  return done;
+}
+
+/* A sample that has to work and read what the model holds */
+static int sample_ok(int16_t *temp)
+{
+  return sample(temp) == 1 && *temp == tcn75a_reg(TEMP_SENSOR_ADDR);
+}
+
+/* Wait up to ms for the alert to become active */
+static int alert_wait(int active, int ms)
+{
+  while (temp_alert_active() != active && ms-- > 0)
+    emu_wait(1000);
+  return temp_alert_active() == active;
+}
+
+/* Format f with fmt as display_printf would, and count it as wrong
+   unless it comes out as want */
+static void format_check(const char *fmt, double f, const char *want)
+{
+  char buf[32];
+
+  format_string(buf, sizeof buf, fmt, f);
+  if (strcmp(buf, want))
+  {
+    printf("format \"%s\" of %g: \"%s\", not \"%s\"\n", fmt, f, buf, want);
+    format_errors++;
+  }
+}
+
+/* Sample the main sensor and poll the others while the script runs,
+   printing each reading, or what went wrong in place of it */
+static void run_script(void)
+{
+  unsigned int t0 = emu_now(), end;
+  int16_t temp;
+  int done, ch;
+
+  if (!tcn75a_load(script))
+  {
+    fprintf(stderr, "%s: cannot load\n", script);
+    exit(2);
+  }
+  end = tcn75a_script_end();
+  printf("\n%8s %8s", "ms", "0x48");
+  for (ch = 1; ch < temp_channels(); ch++)
+    printf("     0x%02X", temp_channel_addr(ch));
+  printf("\n");
+  while ((int)(end - emu_now()) >= 0)
+  {
+    temp_sample_begin();
+    while ((done = temp_sample_poll(&temp)) == 0)
+    {
+      temp_poll();
+      emu_wait(10);
+    }
+    printf("%8u ", (emu_now() - t0) / (1000 * EMU_TICKS_PER_US));
+    if (done > 0)
+      printf("%8.4f", temp / 256.0);
+    else
+      printf("%8d", done);
+    for (ch = 1; ch < temp_channels(); ch++)
+      if ((done = temp_channel_read(ch, &temp)) > 0)
+        printf(" %8.4f", temp / 256.0);
+      else
+        printf(" %8d", done);
+    printf("\n");
+  }
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int t, bps_byte, bps_burst, tps, bps;
+  int16_t temp, prev;
+  int i, ok;
+
+  for (i = 1; i + 1 < argc; i += 2)
+    if (!strcmp(argv[i], "-o"))
+      out_dir = argv[i + 1];
+    else if (!strcmp(argv[i], "-s"))
+      script = argv[i + 1];
+    else
+      break;
+  if (i != argc)
+  {
+    fprintf(stderr, "usage: %s [-o dir] [-s script]\n", argv[0]);
+    return 2;
+  }
+
+  host_setup();
+  printf("%-14s %6s %6s %4s %4s %8s %8s\n", "step", "cmd", "data",
+         "d/c", "w32", "bus us", "us");
+
+  t = step_begin();
+  display_init();
+  step_end("init", t, 0);
+
+  t = step_begin();
+  display_unpack(0, 128, 0, 4, splash_image);
+  display_update();
+  step_end("splash", t, 1);
+
+  t = step_begin();
+  display_clear();
+  display_printf(0, "Temperature");
+  display_printf(1, "%.1f\xB0" "C", 23.5);
+  display_printf(2, "Min. %.1f", 21.25);
+  display_printf(3, "Max. %.1f", 24.0);
+  display_update();
+  step_end("text", t, 1);
+
+  t = step_begin();
+  display_update();
+  step_end("text-same", t, 1);
+
+  t = step_begin();
+  display_printf(1, "%.1f\xB0" "C", 23.6);
+  display_update();
+  step_end("text-digit", t, 1);
+
+  t = step_begin();
+  screen_show(SCREEN_MENU);
+  step_end("menu", t, 1);
+
+  t = step_begin();
+  screen_select(SCREEN_MENU, 1, "> Chose unit");
+  step_end("menu-select", t, 1);
+
+  t = step_begin();
+  screen_show(SCREEN_UNIT);
+  step_end("menu-unit", t, 1);
+
+  t = step_begin();
+  display_clear();
+  bignum_show(0, "23.5\xB0" "C", 3);
+  display_update();
+  step_end("bignum3", t, 1);
+
+  t = step_begin();
+  bignum_show(0, "23.6\xB0" "C", 3);
+  display_update();
+  step_end("bignum3-digit", t, 1);
+
+  t = step_begin();
+  bignum_end();
+  display_update();
+  step_end("bignum-end", t, 1);
+
+  /* The controller wants a frame between two content scrolls */
+  t = step_begin();
+  for (i = 0; i < 48; i++)
+  {
+    trend_push(368 + (i * 7) % 23);
+    emu_wait(10000);
+  }
+  step_end("trend", t, 1);
+
+  t = step_begin();
+  trend_push(370);
+  step_end("trend-push", t, 1);
+
+  t = step_begin();
+  trend_end();
+  display_update();
+  step_end("trend-end", t, 1);
+
+  t = step_begin();
+  hist_start();
+  hist_show();
+  for (i = 0; i < 64; i++)
+    hist_add(368 + (i * 5) % 11);
+  display_update();
+  step_end("hist", t, 1);
+
+  t = step_begin();
+  hist_add(372);
+  display_update();
+  step_end("hist-add", t, 1);
+
+  t = step_begin();
+  hist_end();
+  display_update();
+  step_end("hist-end", t, 1);
+
+  /* The same frame through the SPI2 TX interrupt */
+  enable_interrupt();
+  t = step_begin();
+  display_clear();
+  display_printf(0, "Async");
+  display_printf(2, "%d bytes", 512);
+  display_update_async();
+  while (!display_flush_done())
+    emu_wait(1);
+  step_end("async", t, 1);
+
+  t = step_begin();
+  display_benchmark(&bps_byte, &bps_burst);
+  display_update();
+  step_end("benchmark", t, 1);
+  printf("\nbenchmark: %u bytes/s one at a time, %u bytes/s in bursts\n",
+         bps_byte, bps_burst);
+  printf("%u bytes saved by dirty tracking\n", display_bytes_saved_total);
+
+  /* Two sensors: the one on the shield, and a probe at 0x4B */
+  tcn75a_command("add 0x48");
+  tcn75a_command("temp 0x48 23.5");
+  tcn75a_command("add 0x4B");
+  tcn75a_command("temp 0x4B 19.25");
+  printf("\n%-14s %6s %6s %4s %8s %8s\n", "step", "starts", "bytes",
+         "clk", "bus us", "us");
+
+  t = step_begin();
+  i2c_init();
+  ok = temp_scan(12) == 2 && temp_channel_addr(1) == 0x4B;
+  i2c_step_end("scan", t, ok);
+
+  t = step_begin();
+  temp_mode(12, 0);
+  ok = sample_ok(&temp) && temp == 0x1780;
+  i2c_step_end("sample", t, ok);
+
+  /* The pointer is on the temperature register now */
+  t = step_begin();
+  ok = sample_ok(&temp) && emu_count.i2c_bytes == 3;
+  i2c_step_end("sample-cached", t, ok);
+
+  t = step_begin();
+  temp_whole(1);
+  ok = sample(&temp) == 1 && temp == (tcn75a_reg(TEMP_SENSOR_ADDR) & 0xFF00) &&
+       emu_count.i2c_bytes == 2;
+  temp_whole(0);
+  i2c_step_end("sample-whole", t, ok);
+
+  t = step_begin();
+  temp_mode(12, 1);
+  ok = sample_ok(&temp) && (tcn75a_conf(TEMP_SENSOR_ADDR) & 0x01);
+  temp_mode(12, 0);
+  i2c_step_end("oneshot", t, ok);
+
+  /* Every reading is a new conversion of the rising temperature */
+  t = step_begin();
+  tcn75a_command("ramp 0x48 30 2000");
+  ok = sample(&prev) == 1 && prev >= 0x1780;
+  for (i = 0; i < 9 && ok; i++)
+  {
+    /* A conversion can end just after the read, so the model may be
+       a step ahead, but never behind */
+    ok = sample(&temp) == 1 && temp >= prev && temp <= tcn75a_reg(TEMP_SENSOR_ADDR);
+    prev = temp;
+  }
+  ok = ok && temp == 0x1E00;
+  i2c_step_end("ramp", t, ok);
+
+  t = step_begin();
+  for (i = 0; i < 6000; i++)
+  {
+    temp_poll();
+    emu_wait(100);
+  }
+  ok = temp_channel_read(1, &temp) == 1 && temp == tcn75a_reg(0x4B) && temp == 0x1340;
+  /* The poll leaves the main sensor to temp_sample, whose last
+     reading its channel gives */
+  ok = ok && temp_channel_read(0, &temp) == 1 && temp == prev;
+  i2c_step_end("poll", t, ok);
+
+  t = step_begin();
+  tcn75a_command("nack 0x48 1");
+  ok = sample_ok(&temp);
+  i2c_step_end("nack-retry", t, ok);
+
+  t = step_begin();
+  tcn75a_command("nack 0x48 3");
+  ok = sample(&temp) == -I2C_NACK;
+  i2c_step_end("nack-fail", t, ok);
+
+  /* SCL stretched past the timeout on every try, then let go */
+  t = step_begin();
+  tcn75a_command("stall 0x48 10");
+  ok = sample(&temp) == -I2C_TIMEOUT && emu_now() - t < 10000 * EMU_TICKS_PER_US;
+  emu_wait(10000);
+  ok = ok && sample_ok(&temp);
+  i2c_step_end("stall", t, ok);
+
+  t = step_begin();
+  tcn75a_command("stuck 0x48");
+  ok = sample_ok(&temp) && emu_count.i2c_clocks > 0;
+  i2c_step_end("stuck", t, ok);
+
+  t = step_begin();
+  tcn75a_command("temp 0x48 24");
+  while (!temp_alert_set(25 * 256, 24 * 256, 0))
+    emu_wait(100);
+  tcn75a_command("ramp 0x48 26 500");
+  ok = alert_wait(1, 1000);
+  tcn75a_command("ramp 0x48 23 500");
+  ok = ok && alert_wait(0, 1000);
+  i2c_step_end("alert-comp", t, ok);
+
+  t = step_begin();
+  i = temp_alert_count();
+  while (!temp_alert_set(25 * 256, 24 * 256, 1))
+    emu_wait(100);
+  tcn75a_command("ramp 0x48 26 500");
+  ok = alert_wait(1, 1000);
+  tcn75a_command("ramp 0x48 23 500");
+  ok = ok && alert_wait(0, 1000) && temp_alert_count() - i == 2;
+  i2c_step_end("alert-int", t, ok);
+
+  t = step_begin();
+  i2c_benchmark(&tps, &bps);
+  i2c_step_end("i2c-bench", t, tps > 0);
+  printf("\ni2c benchmark at %u kHz: %u reads/s, %u bytes/s\n", I2C1_HZ / 1000, tps, bps);
+
+  format_check("%.1f", 23.46, "23.5");
+  format_check("%5.1f", -1.5, " -1.5");
+  format_check("%.0f", 4294967295.0, "4294967295");
+  format_check("%.1f", 1e10, "ovf");
+  format_check("%5.1f", -1e10, "  ovf");
+  format_check("%-5.2f", 1e8, "ovf  ");
+
+  if (script)
+    run_script();
+
+  if (mismatches || failures || format_errors || emu_faults)
+  {
+    printf("%d steps with a wrong panel, %d sensor steps failed, "
+           "%d wrong formats, %u faults\n",
+           mismatches, failures, format_errors, emu_faults);
+    return 1;
+  }
+  return 0;
+}
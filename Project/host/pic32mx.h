@@ -0,0 +1,158 @@
+/* pic32mx.h
+   Stand-in for the mcb32 toolchain's pic32mx.h in the host build.
+   Every special function register the display and I2C code use is
+   an lvalue that goes through emu_reg in emu.c, so that the emulator
+   sees each access in program order and can act on it: a byte
+   written to SPI2BUF is shifted out to the display model, a write to
+   PORTFCLR moves the D/C line, a start set in I2C1CON goes out on
+   the sensors' bus, and so on.
+
+   emu_reg returns a slot holding the register's value. The access is
+   acted on at the next emu_reg call: if the slot was changed it was a
+   write, otherwise a read. This needs one register access per
+   expression; an assignment from one register straight into another
+   would be lost.
+
+   Only the registers the host-built files need are here. Add new ones
+   to enum emu_reg_id and as a group of four macros below.
+
+   For copyright and licensing, see file COPYING */
+
+enum emu_reg_id
+{
+  EMU_SPI2CON,
+  EMU_SPI2STAT,
+  EMU_SPI2BUF,
+  EMU_SPI2BRG,
+  EMU_I2C1CON,
+  EMU_I2C1STAT,
+  EMU_I2C1BRG,
+  EMU_I2C1TRN,
+  EMU_I2C1RCV,
+  EMU_TRISD,
+  EMU_PORTD,
+  EMU_TRISE,
+  EMU_PORTE,
+  EMU_TRISF,
+  EMU_PORTF,
+  EMU_TRISG,
+  EMU_PORTG,
+  EMU_ODCG,
+  EMU_INTCON,
+  EMU_IFS0,
+  EMU_IEC0 = EMU_IFS0 + 3,
+  EMU_IPC0 = EMU_IEC0 + 3,
+  EMU_REG_COUNT = EMU_IPC0 + 13
+};
+
+/* How an access combines with the register: plain, or through
+   the CLR, SET and INV addresses */
+#define EMU_OP_PLAIN 0
+#define EMU_OP_CLR 1
+#define EMU_OP_SET 2
+#define EMU_OP_INV 3
+
+volatile unsigned int *emu_reg(int id, int op);
+
+#define EMU_SFR(id, op) (*emu_reg((id), (op)))
+
+#define SPI2CON EMU_SFR(EMU_SPI2CON, EMU_OP_PLAIN)
+#define SPI2CONCLR EMU_SFR(EMU_SPI2CON, EMU_OP_CLR)
+#define SPI2CONSET EMU_SFR(EMU_SPI2CON, EMU_OP_SET)
+#define SPI2CONINV EMU_SFR(EMU_SPI2CON, EMU_OP_INV)
+
+#define SPI2STAT EMU_SFR(EMU_SPI2STAT, EMU_OP_PLAIN)
+#define SPI2STATCLR EMU_SFR(EMU_SPI2STAT, EMU_OP_CLR)
+#define SPI2STATSET EMU_SFR(EMU_SPI2STAT, EMU_OP_SET)
+#define SPI2STATINV EMU_SFR(EMU_SPI2STAT, EMU_OP_INV)
+
+#define SPI2BUF EMU_SFR(EMU_SPI2BUF, EMU_OP_PLAIN)
+
+#define SPI2BRG EMU_SFR(EMU_SPI2BRG, EMU_OP_PLAIN)
+#define SPI2BRGCLR EMU_SFR(EMU_SPI2BRG, EMU_OP_CLR)
+#define SPI2BRGSET EMU_SFR(EMU_SPI2BRG, EMU_OP_SET)
+#define SPI2BRGINV EMU_SFR(EMU_SPI2BRG, EMU_OP_INV)
+
+#define I2C1CON EMU_SFR(EMU_I2C1CON, EMU_OP_PLAIN)
+#define I2C1CONCLR EMU_SFR(EMU_I2C1CON, EMU_OP_CLR)
+#define I2C1CONSET EMU_SFR(EMU_I2C1CON, EMU_OP_SET)
+#define I2C1CONINV EMU_SFR(EMU_I2C1CON, EMU_OP_INV)
+
+#define I2C1STAT EMU_SFR(EMU_I2C1STAT, EMU_OP_PLAIN)
+#define I2C1STATCLR EMU_SFR(EMU_I2C1STAT, EMU_OP_CLR)
+#define I2C1STATSET EMU_SFR(EMU_I2C1STAT, EMU_OP_SET)
+#define I2C1STATINV EMU_SFR(EMU_I2C1STAT, EMU_OP_INV)
+
+#define I2C1BRG EMU_SFR(EMU_I2C1BRG, EMU_OP_PLAIN)
+#define I2C1BRGCLR EMU_SFR(EMU_I2C1BRG, EMU_OP_CLR)
+#define I2C1BRGSET EMU_SFR(EMU_I2C1BRG, EMU_OP_SET)
+#define I2C1BRGINV EMU_SFR(EMU_I2C1BRG, EMU_OP_INV)
+
+#define I2C1TRN EMU_SFR(EMU_I2C1TRN, EMU_OP_PLAIN)
+
+#define I2C1RCV EMU_SFR(EMU_I2C1RCV, EMU_OP_PLAIN)
+
+#define TRISD EMU_SFR(EMU_TRISD, EMU_OP_PLAIN)
+#define TRISDCLR EMU_SFR(EMU_TRISD, EMU_OP_CLR)
+#define TRISDSET EMU_SFR(EMU_TRISD, EMU_OP_SET)
+#define TRISDINV EMU_SFR(EMU_TRISD, EMU_OP_INV)
+
+#define PORTD EMU_SFR(EMU_PORTD, EMU_OP_PLAIN)
+#define PORTDCLR EMU_SFR(EMU_PORTD, EMU_OP_CLR)
+#define PORTDSET EMU_SFR(EMU_PORTD, EMU_OP_SET)
+#define PORTDINV EMU_SFR(EMU_PORTD, EMU_OP_INV)
+
+#define TRISE EMU_SFR(EMU_TRISE, EMU_OP_PLAIN)
+#define TRISECLR EMU_SFR(EMU_TRISE, EMU_OP_CLR)
+#define TRISESET EMU_SFR(EMU_TRISE, EMU_OP_SET)
+#define TRISEINV EMU_SFR(EMU_TRISE, EMU_OP_INV)
+
+#define PORTE EMU_SFR(EMU_PORTE, EMU_OP_PLAIN)
+#define PORTECLR EMU_SFR(EMU_PORTE, EMU_OP_CLR)
+#define PORTESET EMU_SFR(EMU_PORTE, EMU_OP_SET)
+#define PORTEINV EMU_SFR(EMU_PORTE, EMU_OP_INV)
+
+#define TRISF EMU_SFR(EMU_TRISF, EMU_OP_PLAIN)
+#define TRISFCLR EMU_SFR(EMU_TRISF, EMU_OP_CLR)
+#define TRISFSET EMU_SFR(EMU_TRISF, EMU_OP_SET)
+#define TRISFINV EMU_SFR(EMU_TRISF, EMU_OP_INV)
+
+#define PORTF EMU_SFR(EMU_PORTF, EMU_OP_PLAIN)
+#define PORTFCLR EMU_SFR(EMU_PORTF, EMU_OP_CLR)
+#define PORTFSET EMU_SFR(EMU_PORTF, EMU_OP_SET)
+#define PORTFINV EMU_SFR(EMU_PORTF, EMU_OP_INV)
+
+#define TRISG EMU_SFR(EMU_TRISG, EMU_OP_PLAIN)
+#define TRISGCLR EMU_SFR(EMU_TRISG, EMU_OP_CLR)
+#define TRISGSET EMU_SFR(EMU_TRISG, EMU_OP_SET)
+#define TRISGINV EMU_SFR(EMU_TRISG, EMU_OP_INV)
+
+#define PORTG EMU_SFR(EMU_PORTG, EMU_OP_PLAIN)
+#define PORTGCLR EMU_SFR(EMU_PORTG, EMU_OP_CLR)
+#define PORTGSET EMU_SFR(EMU_PORTG, EMU_OP_SET)
+#define PORTGINV EMU_SFR(EMU_PORTG, EMU_OP_INV)
+
+#define ODCG EMU_SFR(EMU_ODCG, EMU_OP_PLAIN)
+#define ODCGCLR EMU_SFR(EMU_ODCG, EMU_OP_CLR)
+#define ODCGSET EMU_SFR(EMU_ODCG, EMU_OP_SET)
+#define ODCGINV EMU_SFR(EMU_ODCG, EMU_OP_INV)
+
+#define INTCON EMU_SFR(EMU_INTCON, EMU_OP_PLAIN)
+#define INTCONCLR EMU_SFR(EMU_INTCON, EMU_OP_CLR)
+#define INTCONSET EMU_SFR(EMU_INTCON, EMU_OP_SET)
+#define INTCONINV EMU_SFR(EMU_INTCON, EMU_OP_INV)
+
+#define IFS(n) EMU_SFR(EMU_IFS0 + (n), EMU_OP_PLAIN)
+#define IFSCLR(n) EMU_SFR(EMU_IFS0 + (n), EMU_OP_CLR)
+#define IFSSET(n) EMU_SFR(EMU_IFS0 + (n), EMU_OP_SET)
+#define IFSINV(n) EMU_SFR(EMU_IFS0 + (n), EMU_OP_INV)
+
+#define IEC(n) EMU_SFR(EMU_IEC0 + (n), EMU_OP_PLAIN)
+#define IECCLR(n) EMU_SFR(EMU_IEC0 + (n), EMU_OP_CLR)
+#define IECSET(n) EMU_SFR(EMU_IEC0 + (n), EMU_OP_SET)
+#define IECINV(n) EMU_SFR(EMU_IEC0 + (n), EMU_OP_INV)
+
+#define IPC(n) EMU_SFR(EMU_IPC0 + (n), EMU_OP_PLAIN)
+#define IPCCLR(n) EMU_SFR(EMU_IPC0 + (n), EMU_OP_CLR)
+#define IPCSET(n) EMU_SFR(EMU_IPC0 + (n), EMU_OP_SET)
+#define IPCINV(n) EMU_SFR(EMU_IPC0 + (n), EMU_OP_INV)
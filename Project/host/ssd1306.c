@@ -0,0 +1,329 @@
+/* ssd1306.c
+   Model of the SSD1306 controller and 128x32 panel on the Basic I/O
+   Shield for the host emulator. It keeps display RAM, runs the
+   commands display_init and display_update send, and checks the
+   power-up timing against the datasheets. Bytes arrive from SPI2 in
+   emu.c together with the level of D/C.
+
+   For copyright and licensing, see file COPYING */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "emu.h"
+
+/* Times that must pass, in core timer ticks */
+#define T_VDD (1000 * EMU_TICKS_PER_US)    /* VDD on to the first byte */
+#define T_RESET (3 * EMU_TICKS_PER_US)     /* Reset pulse, and reset to the first byte */
+#define T_VBAT (100000 * EMU_TICKS_PER_US) /* VBAT on to display on */
+#define T_FRAME (10000 * EMU_TICKS_PER_US) /* Between two content scrolls */
+
+/* Addressing modes set by command 0x20 */
+#define MODE_HORIZONTAL 0
+#define MODE_VERTICAL 1
+#define MODE_PAGE 2
+
+/* Display RAM, 8 pages of 128 columns with bit 0 at the top */
+static uint8_t ram[8][128];
+
+/* Supplies and reset, and when they last changed */
+static int vdd, vbat, in_reset, was_reset;
+static unsigned int t_vdd, t_vbat, t_reset, t_run;
+
+/* Command being collected, and how many bytes it takes */
+static uint8_t cmd[8];
+static int cmd_len, cmd_need;
+
+/* Controller state */
+static int mode;
+static int col, page, col_lo, col_hi, page_lo, page_hi;
+static int start_line, offset;
+static int seg_remap, com_remap;
+static int display_on, inverse, entire_on, charge_pump;
+static int scroll_on, scrolled;
+static unsigned int t_scroll;
+
+static unsigned int garbage = 0x9E3779B9;
+
+/* Bytes a command takes, itself included */
+static int cmd_size(int op)
+{
+  switch (op)
+  {
+  case 0x20: case 0x81: case 0x8D: case 0xA8:
+  case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+    return 2;
+  case 0x21: case 0x22: case 0xA3:
+    return 3;
+  case 0x29: case 0x2A:
+    return 6;
+  case 0x26: case 0x27:
+    return 7;
+  case 0x2C: case 0x2D:
+    return 8;
+  }
+  return 1;
+}
+
+/* Power-on and reset state from the datasheet. Display RAM is not
+   cleared by either, so it is filled with garbage. */
+static void reset_state(void)
+{
+  int i, j;
+
+  for (i = 0; i < 8; i++)
+    for (j = 0; j < 128; j++)
+    {
+      garbage = garbage * 1664525 + 1013904223;
+      ram[i][j] = garbage >> 24;
+    }
+  cmd_len = 0;
+  mode = MODE_PAGE;
+  col = page = 0;
+  col_lo = 0;
+  col_hi = 127;
+  page_lo = 0;
+  page_hi = 7;
+  start_line = offset = 0;
+  seg_remap = com_remap = 0;
+  display_on = inverse = entire_on = charge_pump = 0;
+  scroll_on = scrolled = 0;
+}
+
+/* ssd1306_pins:
+   The levels of VDD, VBAT and reset, 1 for on or asserted. */
+void ssd1306_pins(int new_vdd, int new_vbat, int new_reset, unsigned int now)
+{
+  if (new_vdd && !vdd)
+  {
+    t_vdd = now;
+    was_reset = 0;
+    reset_state();
+  }
+  if (new_vbat && !vbat)
+  {
+    if (!new_vdd)
+      emu_fault("VBAT switched on before VDD");
+    t_vbat = now;
+  }
+  if (new_reset && !in_reset)
+    t_reset = now;
+  if (!new_reset && in_reset)
+  {
+    if (now - t_reset < T_RESET)
+      emu_fault("reset pulse shorter than 3 us");
+    t_run = now;
+    was_reset = 1;
+    reset_state();
+  }
+  vdd = new_vdd;
+  vbat = new_vbat;
+  in_reset = new_reset;
+}
+
+/* Shift columns lo to hi of pages p0 to p1 one step, towards column
+   0 for 0x2D and away from it for 0x2C. The column shifted out comes
+   back in at the other end. */
+static void content_scroll(int left, int p0, int p1, int lo, int hi)
+{
+  int p, c;
+  uint8_t t;
+
+  for (p = p0; p <= p1; p++)
+    if (left)
+    {
+      t = ram[p][lo];
+      for (c = lo; c < hi; c++)
+        ram[p][c] = ram[p][c + 1];
+      ram[p][hi] = t;
+    }
+    else
+    {
+      t = ram[p][hi];
+      for (c = hi; c > lo; c--)
+        ram[p][c] = ram[p][c - 1];
+      ram[p][lo] = t;
+    }
+}
+
+static void command(unsigned int now)
+{
+  int op = cmd[0];
+  char what[64];
+
+  if (op < 0x10)
+    col = (col & 0x70) | op;
+  else if (op < 0x20)
+    col = (col & 0x0F) | (op & 0x07) << 4;
+  else if (op >= 0x40 && op < 0x80)
+    start_line = op & 0x3F;
+  else if (op >= 0xB0 && op < 0xB8)
+    page = op & 7;
+  else
+    switch (op)
+    {
+    case 0x20:
+      if ((cmd[1] & 3) == 3)
+        emu_fault("invalid addressing mode");
+      mode = cmd[1] & 3;
+      break;
+    case 0x21:
+      col = col_lo = cmd[1] & 0x7F;
+      col_hi = cmd[2] & 0x7F;
+      break;
+    case 0x22:
+      page = page_lo = cmd[1] & 7;
+      page_hi = cmd[2] & 7;
+      break;
+    case 0x2C:
+    case 0x2D:
+      if (scroll_on)
+        emu_fault("content scroll while continuous scroll is on");
+      if (cmd[1] != 0x00 || cmd[3] != 0x01 || cmd[5] != 0x00)
+        emu_fault("content scroll with wrong dummy bytes");
+      if (scrolled && now - t_scroll < T_FRAME)
+        emu_fault("content scroll less than a frame after the last one");
+      scrolled = 1;
+      t_scroll = now;
+      content_scroll(op == 0x2D, cmd[2] & 7, cmd[4] & 7, cmd[6] & 0x7F, cmd[7] & 0x7F);
+      break;
+    case 0x2E:
+      scroll_on = 0;
+      break;
+    case 0x2F:
+      scroll_on = 1;
+      break;
+    case 0x8D:
+      charge_pump = (cmd[1] & 0x04) != 0;
+      break;
+    case 0xA0:
+    case 0xA1:
+      seg_remap = op & 1;
+      break;
+    case 0xA4:
+    case 0xA5:
+      entire_on = op & 1;
+      break;
+    case 0xA6:
+    case 0xA7:
+      inverse = op & 1;
+      break;
+    case 0xAE:
+      display_on = 0;
+      break;
+    case 0xAF:
+      if (!vbat || now - t_vbat < T_VBAT)
+        emu_fault("display switched on before VBAT settled");
+      display_on = 1;
+      break;
+    case 0xC0:
+    case 0xC8:
+      com_remap = (op & 0x08) != 0;
+      break;
+    case 0xD3:
+      offset = cmd[1] & 0x3F;
+      break;
+    case 0x26: case 0x27: case 0x29: case 0x2A:
+    case 0x81: case 0xA3: case 0xA8: case 0xD5:
+    case 0xD9: case 0xDA: case 0xDB: case 0xE3:
+      /* Accepted, but they do not change what the model shows */
+      break;
+    default:
+      sprintf(what, "unknown command 0x%02X", op);
+      emu_fault(what);
+      break;
+    }
+}
+
+/* Store a data byte and move on, as the addressing mode says */
+static void data(uint8_t b)
+{
+  if (scroll_on)
+    emu_fault("display RAM written while scrolling");
+  ram[page][col] = b;
+  switch (mode)
+  {
+  case MODE_HORIZONTAL:
+    if (col++ == col_hi)
+    {
+      col = col_lo;
+      page = page == page_hi ? page_lo : page + 1;
+    }
+    break;
+  case MODE_VERTICAL:
+    if (page++ == page_hi)
+    {
+      page = page_lo;
+      col = col == col_hi ? col_lo : col + 1;
+    }
+    break;
+  default:
+    col = (col + 1) & 0x7F;
+    break;
+  }
+}
+
+/* ssd1306_byte:
+   A byte clocked in over SPI, with D/C high for display RAM. */
+void ssd1306_byte(int dc, unsigned int byte, unsigned int now)
+{
+  if (!vdd || in_reset)
+  {
+    emu_fault("byte sent to the display while it is off or in reset");
+    return;
+  }
+  if (now - t_vdd < T_VDD)
+    emu_fault("byte sent less than 1 ms after VDD on");
+  if (was_reset && now - t_run < T_RESET)
+    emu_fault("byte sent less than 3 us after reset");
+
+  if (dc)
+  {
+    if (cmd_len > 0)
+      emu_fault("data byte in the middle of a command");
+    cmd_len = 0;
+    data(byte);
+    return;
+  }
+  if (cmd_len == 0)
+    cmd_need = cmd_size(byte);
+  cmd[cmd_len++] = byte;
+  if (cmd_len == cmd_need)
+  {
+    command(now);
+    cmd_len = 0;
+  }
+}
+
+/* ssd1306_pixel:
+   1 if the pixel at column x, row y of the panel is lit. The panel
+   is mapped so that 0xA1 and 0xC8, as display_init sends them, show
+   display RAM the right way up. */
+int ssd1306_pixel(int x, int y)
+{
+  int row, c;
+
+  if (!vdd || !vbat || in_reset || !charge_pump || !display_on)
+    return 0;
+  if (entire_on)
+    return 1;
+  row = ((com_remap ? y : 31 - y) + start_line + offset) & 0x3F;
+  c = seg_remap ? x : 127 - x;
+  return ((ram[row >> 3][c] >> (row & 7)) & 1) ^ inverse;
+}
+
+/* ssd1306_write_pbm:
+   Write what the panel shows as a plain PBM, like the ones in
+   assets/. Returns 0 if the file could not be written. */
+int ssd1306_write_pbm(const char *name)
+{
+  FILE *f = fopen(name, "w");
+  int x, y;
+
+  if (!f)
+    return 0;
+  fprintf(f, "P1\n128 32\n");
+  for (y = 0; y < 32; y++)
+    for (x = 0; x < 128; x++)
+      fprintf(f, "%d%s", ssd1306_pixel(x, y), x % 32 == 31 ? "\n" : " ");
+  return fclose(f) == 0;
+}
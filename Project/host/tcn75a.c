@@ -0,0 +1,565 @@
+/* tcn75a.c
+   Model of TCN75A temperature sensors on I2C1 for the host emulator.
+   Up to eight sit at 0x48 to 0x4F. Each keeps its registers and
+   register pointer, converts on its own clock at the resolution its
+   configuration sets, continuously or one shot at a time, and drives
+   its ALERT output in comparator or interrupt mode. Bus events come
+   from the I2C1 model in emu.c.
+
+   What each sensor measures, and the faults it shows, are set with
+   commands, either at once with tcn75a_command or at given times from
+   a script loaded with tcn75a_load:
+
+     temp ADDR DEG       the temperature is DEG degrees Celsius
+     ramp ADDR DEG MS    it moves in a straight line to DEG over MS ms
+     nack ADDR N         the next N address bytes are not acknowledged
+     stall ADDR MS       after its next address byte, SCL is held low
+                         for MS ms
+     stuck ADDR          SDA is held low until nine clocks on SCL,
+                         as after a master that reset mid-byte
+     add ADDR            a sensor is on the bus
+     remove ADDR         it is gone, and answers nothing
+
+   A script has one command a line after the time in ms from when it
+   was loaded. Lines starting with # are comments.
+
+   For copyright and licensing, see file COPYING */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "emu.h"
+
+#define BASE_ADDR 0x48
+#define SENSORS 8
+
+/* Registers, as the pointer byte selects them */
+#define REG_TEMP 0
+#define REG_CONF 1
+#define REG_HYST 2
+#define REG_LIMIT 3
+
+/* CONF bits */
+#define CONF_SHUTDOWN 0x01
+#define CONF_INT_MODE 0x02
+#define CONF_ALERT_POL 0x04 /* Active high */
+#define CONF_RES(conf) (((conf) >> 5) & 3)
+#define CONF_ONESHOT 0x80
+
+/* Conversion time in ms for 9 to 12 bits. The model uses the typical
+   values, as the driver does. */
+static const unsigned int conv_ms[4] = {30, 60, 120, 240};
+
+/* Where a sensor is in a transfer */
+#define BUS_IDLE 0    /* Not addressed */
+#define BUS_ADDR 1    /* After a start, the address byte comes next */
+#define BUS_POINTER 2 /* Addressed to write, the pointer comes next */
+#define BUS_WRITE 3   /* Data bytes to the register at the pointer */
+#define BUS_READ 4    /* Sending the register at the pointer */
+
+#define TICKS_PER_MS (1000 * EMU_TICKS_PER_US)
+#define STUCK_CLOCKS 9
+
+struct sensor
+{
+  int present;
+  uint8_t pointer, conf;
+  uint16_t temp, hyst, limit;
+
+  /* What it measures: from deg0 at t0 in a line to deg1 at t1 */
+  double deg0, deg1;
+  unsigned int t0, t1;
+
+  /* The conversion running, if converting, and when it ends */
+  int converting;
+  unsigned int conv_end;
+
+  /* ALERT: asserted, and in interrupt mode whether the next event is
+     the temperature going under T_HYST */
+  int alert, armed_low;
+
+  /* Transfer state */
+  int bus, index;
+  uint8_t wbuf[2];
+  uint16_t rbuf;
+
+  /* Faults to show */
+  int nacks;
+  unsigned int stall_ms, stall_end;
+  int stalling, stuck;
+};
+
+static struct sensor sensors[SENSORS];
+
+/* A timed script */
+struct event
+{
+  unsigned int at;
+  char line[64];
+};
+
+static struct event *events;
+static int event_count, event_next;
+
+/* Time of the last tcn75a_run, for commands run at once */
+static unsigned int model_now;
+
+static int after(unsigned int t, unsigned int ref)
+{
+  return (int)(t - ref) >= 0;
+}
+
+/* The temperature a sensor sees at time now */
+static double measured(struct sensor *s, unsigned int now)
+{
+  if (after(now, s->t1) || s->t1 == s->t0)
+    return s->deg1;
+  if (!after(now, s->t0))
+    return s->deg0;
+  return s->deg0 + (s->deg1 - s->deg0) * (double)(now - s->t0) / (double)(s->t1 - s->t0);
+}
+
+/* Degrees as the temperature register holds them at the configured
+   resolution: two's complement 1/256 degrees, bits below it clear */
+static uint16_t to_reg(double deg, int res)
+{
+  static const uint16_t mask[4] = {0xFF80, 0xFFC0, 0xFFE0, 0xFFF0};
+  long v = (long)(deg * 256.0 + (deg < 0 ? -0.999 : 0));
+
+  if (v > 0x7FFF)
+    v = 0x7FFF;
+  if (v < -0x8000)
+    v = -0x8000;
+  return (uint16_t)v & mask[res];
+}
+
+static void start_conversion(struct sensor *s, unsigned int now)
+{
+  s->converting = 1;
+  s->conv_end = now + conv_ms[CONF_RES(s->conf)] * TICKS_PER_MS;
+}
+
+/* A conversion is done: update the register and the alert */
+static void conversion_done(struct sensor *s, unsigned int now)
+{
+  int16_t t;
+
+  s->temp = to_reg(measured(s, now), CONF_RES(s->conf));
+  t = (int16_t)s->temp;
+
+  if (s->conf & CONF_INT_MODE)
+  {
+    /* One assertion per crossing, held until a register is read */
+    if (!s->armed_low && t >= (int16_t)s->limit)
+    {
+      s->alert = 1;
+      s->armed_low = 1;
+    }
+    else if (s->armed_low && t < (int16_t)s->hyst)
+    {
+      s->alert = 1;
+      s->armed_low = 0;
+    }
+  }
+  else if (t >= (int16_t)s->limit)
+    s->alert = 1;
+  else if (t < (int16_t)s->hyst)
+    s->alert = 0;
+
+  s->converting = 0;
+  if (!(s->conf & CONF_SHUTDOWN))
+    start_conversion(s, now);
+}
+
+static void power_on(struct sensor *s, unsigned int now)
+{
+  double deg = s->deg1;
+
+  memset(s, 0, sizeof(*s));
+  s->present = 1;
+  s->hyst = 0x4B00;  /* 75 degrees */
+  s->limit = 0x5000; /* 80 degrees */
+  s->deg0 = s->deg1 = deg;
+  s->t0 = s->t1 = now;
+  start_conversion(s, now);
+}
+
+static struct sensor *sensor_at(int addr)
+{
+  if (addr < BASE_ADDR || addr >= BASE_ADDR + SENSORS)
+    return 0;
+  return &sensors[addr - BASE_ADDR];
+}
+
+/* tcn75a_command:
+   Run one of the commands above now. Returns 0 if it is not one. */
+int tcn75a_command(const char *line)
+{
+  char cmd[16];
+  int addr, n;
+  double a, b = 0;
+  struct sensor *s;
+
+  n = sscanf(line, "%15s %i %lf %lf", cmd, &addr, &a, &b);
+  if (n < 2 || !(s = sensor_at(addr)))
+    return 0;
+
+  if (!strcmp(cmd, "temp") && n >= 3)
+  {
+    s->deg0 = s->deg1 = a;
+    s->t0 = s->t1 = model_now;
+  }
+  else if (!strcmp(cmd, "ramp") && n == 4)
+  {
+    s->deg0 = measured(s, model_now);
+    s->deg1 = a;
+    s->t0 = model_now;
+    s->t1 = model_now + (unsigned int)(b * TICKS_PER_MS);
+  }
+  else if (!strcmp(cmd, "nack") && n >= 3)
+    s->nacks = (int)a;
+  else if (!strcmp(cmd, "stall") && n >= 3)
+    s->stall_ms = (unsigned int)a;
+  else if (!strcmp(cmd, "stuck"))
+    s->stuck = STUCK_CLOCKS;
+  else if (!strcmp(cmd, "add"))
+  {
+    if (!s->present)
+      power_on(s, model_now);
+  }
+  else if (!strcmp(cmd, "remove"))
+    s->present = 0;
+  else
+    return 0;
+  return 1;
+}
+
+/* tcn75a_load:
+   Read a script, to run from now on. Returns 0 if the file could not
+   be read or has a line that is not a command. */
+int tcn75a_load(const char *name)
+{
+  FILE *f = fopen(name, "r");
+  char line[128];
+  unsigned int ms;
+  int pos, lineno = 0;
+
+  if (!f)
+    return 0;
+  while (fgets(line, sizeof(line), f))
+  {
+    lineno++;
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[strspn(line, " \t")] == '#' || line[strspn(line, " \t")] == 0)
+      continue;
+    if (sscanf(line, "%u %n", &ms, &pos) != 1 || strlen(line + pos) >= sizeof(events->line))
+    {
+      fprintf(stderr, "%s:%d: bad line\n", name, lineno);
+      fclose(f);
+      return 0;
+    }
+    events = realloc(events, (event_count + 1) * sizeof(*events));
+    if (!events)
+    {
+      fclose(f);
+      return 0;
+    }
+    events[event_count].at = model_now + ms * TICKS_PER_MS;
+    strcpy(events[event_count].line, line + pos);
+    event_count++;
+  }
+  fclose(f);
+  return 1;
+}
+
+/* tcn75a_script_end:
+   When the last command of the script runs, or now if none is left. */
+unsigned int tcn75a_script_end(void)
+{
+  unsigned int end = model_now;
+  int i;
+
+  for (i = event_next; i < event_count; i++)
+    if (after(events[i].at, end))
+      end = events[i].at;
+  return end;
+}
+
+/* tcn75a_run:
+   Let the sensors run up to now: scripted commands, conversions and
+   the end of stalls. */
+void tcn75a_run(unsigned int now)
+{
+  struct sensor *s;
+  int i;
+
+  model_now = now;
+  while (event_next < event_count && after(now, events[event_next].at))
+  {
+    if (!tcn75a_command(events[event_next].line))
+      fprintf(stderr, "tcn75a: not a command: %s\n", events[event_next].line);
+    event_next++;
+  }
+  for (s = sensors, i = 0; i < SENSORS; s++, i++)
+  {
+    if (!s->present)
+      continue;
+    if (s->converting && after(now, s->conv_end))
+      conversion_done(s, s->conv_end);
+    if (s->stalling && after(now, s->stall_end))
+      s->stalling = 0;
+  }
+}
+
+/* tcn75a_holding_scl:
+   1 while a sensor stretches the clock, so that nothing on the bus
+   can finish. */
+int tcn75a_holding_scl(void)
+{
+  int i;
+
+  for (i = 0; i < SENSORS; i++)
+    if (sensors[i].present && sensors[i].stalling)
+      return 1;
+  return 0;
+}
+
+/* tcn75a_holding_sda:
+   1 while a stuck sensor holds SDA low. */
+int tcn75a_holding_sda(void)
+{
+  int i;
+
+  for (i = 0; i < SENSORS; i++)
+    if (sensors[i].present && sensors[i].stuck)
+      return 1;
+  return 0;
+}
+
+/* tcn75a_clock:
+   A clock pulse on SCL made by hand with I2C1 off. Nine free a stuck
+   sensor. */
+void tcn75a_clock(void)
+{
+  int i;
+
+  for (i = 0; i < SENSORS; i++)
+    if (sensors[i].stuck > 0)
+      sensors[i].stuck--;
+}
+
+/* tcn75a_start:
+   A start or repeated start: every sensor listens for its address. */
+void tcn75a_start(void)
+{
+  int i;
+
+  for (i = 0; i < SENSORS; i++)
+    sensors[i].bus = BUS_ADDR;
+}
+
+/* tcn75a_stop:
+   A stop ends the transfer. */
+void tcn75a_stop(void)
+{
+  int i;
+
+  for (i = 0; i < SENSORS; i++)
+  {
+    if (sensors[i].bus == BUS_WRITE && sensors[i].index == 1 && sensors[i].pointer >= REG_HYST)
+      emu_fault("TCN75A: one byte written to a two-byte register");
+    sensors[i].bus = BUS_IDLE;
+  }
+}
+
+/* Data byte written to the register at the pointer */
+static void write_reg(struct sensor *s, uint8_t b, unsigned int now)
+{
+  switch (s->pointer)
+  {
+  case REG_TEMP:
+    emu_fault("TCN75A: write to the temperature register");
+    break;
+
+  case REG_CONF:
+    if (s->index > 0)
+    {
+      emu_fault("TCN75A: more than one byte written to CONF");
+      break;
+    }
+    s->conf = b & ~CONF_ONESHOT;
+    if (b & CONF_ONESHOT)
+    {
+      if (!(b & CONF_SHUTDOWN))
+        emu_fault("TCN75A: one-shot bit set out of shutdown");
+      else if (!s->converting)
+        start_conversion(s, now);
+    }
+    else if (!(b & CONF_SHUTDOWN) && !s->converting)
+      start_conversion(s, now);
+    else if (b & CONF_SHUTDOWN)
+      s->converting = 0;
+    if (!(s->conf & CONF_INT_MODE))
+      s->armed_low = 0;
+    break;
+
+  default:
+    if (s->index > 1)
+    {
+      emu_fault("TCN75A: more than two bytes written to a limit");
+      break;
+    }
+    s->wbuf[s->index] = b;
+    if (s->index == 1)
+    {
+      if (s->wbuf[1] & 0x7F)
+        emu_fault("TCN75A: limit with bits below half a degree");
+      if (s->pointer == REG_HYST)
+        s->hyst = (s->wbuf[0] << 8 | s->wbuf[1]) & 0xFF80;
+      else
+        s->limit = (s->wbuf[0] << 8 | s->wbuf[1]) & 0xFF80;
+    }
+    break;
+  }
+  s->index++;
+}
+
+/* tcn75a_write:
+   A byte from the master, after a start or as data. Returns 1 if a
+   sensor acknowledged it. */
+int tcn75a_write(unsigned int byte, unsigned int now)
+{
+  struct sensor *s;
+  int i, ack = 0;
+
+  for (s = sensors, i = 0; i < SENSORS; s++, i++)
+  {
+    if (!s->present)
+      continue;
+    switch (s->bus)
+    {
+    case BUS_ADDR:
+      s->bus = BUS_IDLE;
+      if ((byte >> 1) != BASE_ADDR + i)
+        break;
+      if (s->nacks > 0)
+      {
+        s->nacks--;
+        break;
+      }
+      ack = 1;
+      s->index = 0;
+      s->bus = byte & 1 ? BUS_READ : BUS_POINTER;
+      if (byte & 1)
+      {
+        /* Reading any register lets an interrupt-mode alert go */
+        if (s->conf & CONF_INT_MODE)
+          s->alert = 0;
+      }
+      if (s->stall_ms)
+      {
+        s->stalling = 1;
+        s->stall_end = now + s->stall_ms * TICKS_PER_MS;
+        s->stall_ms = 0;
+      }
+      break;
+
+    case BUS_POINTER:
+      if (byte & 0xFC)
+        emu_fault("TCN75A: pointer byte with reserved bits set");
+      s->pointer = byte & 3;
+      s->bus = BUS_WRITE;
+      ack = 1;
+      break;
+
+    case BUS_WRITE:
+      write_reg(s, byte, now);
+      ack = 1;
+      break;
+
+    case BUS_READ:
+      emu_fault("TCN75A: master wrote while the sensor was sending");
+      break;
+    }
+  }
+  return ack;
+}
+
+/* tcn75a_read:
+   The byte the addressed sensor sends, or 0xFF from the pull-ups
+   if none does. */
+unsigned int tcn75a_read(void)
+{
+  struct sensor *s;
+  unsigned int b = 0xFF;
+  uint16_t v;
+  int i;
+
+  for (s = sensors, i = 0; i < SENSORS; s++, i++)
+  {
+    if (!s->present || s->bus != BUS_READ)
+      continue;
+    if (s->pointer == REG_CONF)
+      b = s->conf;
+    else
+    {
+      /* Both bytes come from the register as it was at the first, so
+         a conversion ending in between does not tear the reading */
+      if (!(s->index & 1))
+        s->rbuf = s->pointer == REG_TEMP ? s->temp : s->pointer == REG_HYST ? s->hyst : s->limit;
+      v = s->rbuf;
+      b = s->index & 1 ? v & 0xFF : v >> 8;
+    }
+    s->index++;
+  }
+  if (tcn75a_holding_sda())
+    b = 0;
+  return b;
+}
+
+/* tcn75a_ack:
+   The master's acknowledge after a byte it read. A not acknowledge
+   ends what the sensor sends. */
+void tcn75a_ack(int ack)
+{
+  int i;
+
+  if (ack)
+    return;
+  for (i = 0; i < SENSORS; i++)
+    if (sensors[i].bus == BUS_READ)
+      sensors[i].bus = BUS_IDLE;
+}
+
+/* tcn75a_alert_pin:
+   Level of the ALERT output of the sensor at TEMP_SENSOR_ADDR, the
+   one the shield wires to RD8. Open drain with a pull-up, so high
+   when it is not there. */
+int tcn75a_alert_pin(void)
+{
+  struct sensor *s = &sensors[0];
+
+  if (!s->present)
+    return 1;
+  return s->conf & CONF_ALERT_POL ? s->alert : !s->alert;
+}
+
+/* tcn75a_reg:
+   The temperature register of the sensor at addr as it is now, for
+   checking what the driver read. */
+int tcn75a_reg(int addr)
+{
+  struct sensor *s = sensor_at(addr);
+
+  return s ? (int16_t)s->temp : 0;
+}
+
+/* tcn75a_conf:
+   The configuration register of the sensor at addr. */
+int tcn75a_conf(int addr)
+{
+  struct sensor *s = sensor_at(addr);
+
+  return s ? s->conf : 0;
+}
@@ -9,16 +9,41 @@
 
 /* Declare display-related functions from mipslabfunc.c */
 void display_image(int x, const uint8_t *data);
+void display_window(int x, int w, int page, int pages, const uint8_t *data);
 void display_init(void);
+void display_init_start(void);
+int display_init_poll(void);
+void display_invalidate(void);
+void display_clear(void);
+void display_pixel(int x, int y, int on);
+void display_line(int x0, int y0, int x1, int y1, int on);
+void display_rect(int x, int y, int w, int h, int on);
+void display_fill_rect(int x, int y, int w, int h, int on);
+void display_bitmap(int x, int w, int page, int pages, const uint8_t *data, int invert);
+void display_blit(int x, int y, int w, int h, const uint8_t *data, int opaque);
+int display_text(int x, int y, const char *s, int opaque);
+void display_render_text(void);
+void display_text_invalidate(void);
+void display_unpack(int x, int w, int page, int pages, const uint8_t *src);
+void display_screen(const uint8_t *image, const char *const lines[4]);
+void display_scroll_column(int page, int pages, const uint8_t *column);
 void display_string(int line, char *s);
+int display_printf(int line, const char *fmt, ...);
+int format_string(char *dst, int size, const char *fmt, ...);
 void display_update(void);
+int display_update_async(void);
+int display_flush_done(void);
+void display_isr(void);
 uint8_t spi_send_recv(uint8_t data);
+void spi_send_burst(const uint8_t *p, int len, int invert);
+void display_benchmark(unsigned int *bps_byte, unsigned int *bps_burst);
 
 /* Declare lab-related functions from mipslabfunc.c */
 char *itoaconv(int num);
 void labwork(void);
 int nextprime(int inval);
 void quicksleep(int cyc);
+void delay_us(unsigned int us);
 void tick(unsigned int *timep);
 
 /* Declare display_debug - a function to help debugging.
@@ -29,18 +54,139 @@ void tick(unsigned int *timep);
 
    There's one parameter: the address to read and display.
 
-   Note: When you use this function, you should comment out any
-   repeated calls to display_image; display_image overwrites
-   about half of the digits shown by display_debug.
+   Note: Text and images share one framebuffer, and whatever is
+   drawn last over a cell is what shows. A display_image call after
+   display_debug still hides about half of its digits.
 */
 void display_debug(volatile int *const addr);
 
-/* Declare bitmap array containing font */
-extern const uint8_t const font[128 * 8];
+/* Declare the font, generated into mipslabassets.c from assets/font.pbm.
+   Characters are ISO 8859-1, so a degree sign is "\xB0" and a is
+   "\xE5". Only the characters the sources use get a glyph: character c
+   is drawn with font_glyphs[font_map[c]], and the rest with the blank
+   glyph 0. Run make assets after using a new one. */
+extern const uint8_t font_glyphs[][8];
+extern const uint8_t font_map[256];
+void font_glyph(int c, uint8_t *dst);
+
+/* Declare the start-up image, packed for display_unpack */
+extern const uint8_t splash_image[];
 
 /* Declare text buffer for display output */
 extern char textbuffer[4][16];
 
+/* Declare the back frame that text and graphics are drawn into,
+   page by page as the display stores it. It changes on every
+   display_update, so never keep a copy of the pointer. */
+extern uint8_t (*framebuffer)[128];
+
+/* SPI bytes saved by dirty-cell tracking in display_update,
+   for the last frame and since start-up */
+extern unsigned int display_bytes_saved;
+extern unsigned int display_bytes_saved_total;
+
+/* Declare trend chart functions from mipslabchart.c.
+   Values are in sixteenths of a degree, as the sensor reports them. */
+void trend_push(int value);
+void trend_end(void);
+
+/* Declare histogram functions from mipslabchart.c, values as above */
+void hist_start(void);
+void hist_show(void);
+void hist_add(int value);
+void hist_stats(int *n, int *min, int *max, int *sum);
+void hist_end(void);
+
+/* Declare large readout functions from mipslabgfx.c */
+void bignum_show(int page, const char *s, int scale);
+void bignum_end(void);
+
+/* Menu screens, pre-rendered at build time from assets/screens.def
+   into mipslabassets.c and packed for display_unpack. screen_show is
+   in mipslabgfx.c. */
+enum screen_id
+{
+#define SCREEN(id, l0, l1, l2, l3) id,
+#include "assets/screens.def"
+#undef SCREEN
+  SCREEN_COUNT
+};
+extern const uint8_t *const screen_images[SCREEN_COUNT];
+void screen_show(int id);
+void screen_select(int id, int line, char *text);
+
+/* Declare I2C functions from mipslabi2c.c. A descriptor is one
+   transfer: write wlen bytes from w, then read rlen bytes into r.
+   Descriptors are run in batches by i2c_submit. */
+#define I2C_OK 0
+#define I2C_BUSY 1
+#define I2C_NACK 2
+#define I2C_COLLISION 3
+#define I2C_TIMEOUT 4
+struct i2c_desc
+{
+  uint8_t addr;
+  uint8_t wlen;
+  uint8_t rlen;
+  volatile int8_t status;
+  const uint8_t *w;
+  uint8_t *r;
+};
+#ifndef I2C1_HZ
+#define I2C1_HZ 400000 /* 100000, 400000, or 1000000 beyond the TCN75A's rating */
+#endif
+void i2c_init(void);
+int i2c_submit(struct i2c_desc *d, int n, void (*done)(struct i2c_desc *d, int n));
+void i2c_service(void);
+int i2c_recover(void);
+void i2c_benchmark(unsigned int *tps, unsigned int *bps);
+void i2c_isr(void);
+
+/* Address of the TCN75A temperature sensor on the I2C bus,
+   and its internal registers. Further sensors can be at the
+   TEMP_CHANNEL_MAX addresses from it. */
+#define TEMP_SENSOR_ADDR 0x48
+#define TEMP_CHANNEL_MAX 8
+typedef enum TempSensorReg TempSensorReg;
+enum TempSensorReg
+{
+  TEMP_SENSOR_REG_TEMP,
+  TEMP_SENSOR_REG_CONF,
+  TEMP_SENSOR_REG_HYST,
+  TEMP_SENSOR_REG_LIMIT,
+};
+int temp_read_begin(void);
+int temp_read_poll(int16_t *temp);
+int temp_mode(int bits, int oneshot);
+void temp_whole(int on);
+void temp_retry(int n);
+unsigned int temp_conversion_ms(void);
+int temp_sample_begin(void);
+int temp_sample_poll(int16_t *temp);
+int temp_scan(int bits);
+void temp_poll(void);
+int temp_channels(void);
+int temp_channel_addr(int ch);
+int temp_channel_read(int ch, int16_t *temp);
+int temp_alert_set(int16_t limit, int16_t hyst, int interrupt);
+int temp_alert_active(void);
+unsigned int temp_alert_count(void);
+void temp_alert_isr(void);
+
+/* Declare core_timer from labwork.S: reads the CP0 Count register,
+   which ticks at half the 80 MHz system clock */
+#define CORE_TIMER_HZ 40000000
+unsigned int core_timer(void);
+
+/* Peripheral bus clock, with PBDIV at 1:1 as main sets it */
+#define PBCLK_HZ 80000000
+
+/* Declare disable_interrupt and restore_interrupt from labwork.S:
+   disable_interrupt returns the previous CP0 Status, which
+   restore_interrupt takes to turn interrupts back on if they were */
+unsigned int disable_interrupt(void);
+void restore_interrupt(unsigned int status);
+
 /* Declare functions written by students.
    Note: Since we declare these functions here,
    students must define their functions with the exact types
@@ -0,0 +1,180 @@
+/* mipslabassets.c
+   Generated by tools/mkassets from the files in assets/.
+   Do not edit, run make assets instead.
+
+   For copyright and licensing, see file COPYING */
+
+#include <stdint.h>  /* Declarations of uint_32 and the like */
+#include <pic32mx.h> /* Declarations of system-specific addresses etc */
+#include "mipslab.h" /* Declatations for these labs */
+
+const uint8_t font_glyphs[][8] __attribute__((aligned(4))) = {
+  {0, 0, 0, 0, 0, 0, 0, 0},
+  {0, 0, 0, 94, 0, 0, 0, 0}, /* ! */
+  {0, 70, 38, 16, 8, 100, 98, 0}, /* % */
+  {0, 0, 0, 128, 96, 0, 0, 0}, /* , */
+  {0, 8, 8, 8, 8, 8, 0, 0}, /* - */
+  {0, 0, 0, 0, 96, 0, 0, 0}, /* . */
+  {0, 64, 32, 16, 8, 4, 2, 0}, /* / */
+  {0, 62, 65, 73, 65, 62, 0, 0}, /* 0 */
+  {0, 0, 66, 127, 64, 0, 0, 0}, /* 1 */
+  {0, 0, 98, 81, 73, 70, 0, 0}, /* 2 */
+  {0, 0, 34, 73, 73, 54, 0, 0}, /* 3 */
+  {0, 0, 14, 8, 127, 8, 0, 0}, /* 4 */
+  {0, 0, 35, 69, 69, 57, 0, 0}, /* 5 */
+  {0, 0, 62, 73, 73, 50, 0, 0}, /* 6 */
+  {0, 0, 1, 97, 25, 7, 0, 0}, /* 7 */
+  {0, 0, 54, 73, 73, 54, 0, 0}, /* 8 */
+  {0, 0, 6, 9, 9, 126, 0, 0}, /* 9 */
+  {0, 0, 0, 102, 0, 0, 0, 0}, /* : */
+  {0, 0, 126, 9, 9, 126, 0, 0}, /* A */
+  {0, 0, 127, 73, 73, 54, 0, 0}, /* B */
+  {0, 0, 62, 65, 65, 34, 0, 0}, /* C */
+  {0, 0, 127, 65, 65, 62, 0, 0}, /* D */
+  {0, 0, 127, 73, 73, 65, 0, 0}, /* E */
+  {0, 0, 127, 9, 9, 1, 0, 0}, /* F */
+  {0, 0, 62, 65, 81, 50, 0, 0}, /* G */
+  {0, 0, 127, 8, 8, 127, 0, 0}, /* H */
+  {0, 0, 65, 127, 65, 0, 0, 0}, /* I */
+  {0, 0, 127, 8, 20, 99, 0, 0}, /* K */
+  {0, 127, 2, 4, 2, 127, 0, 0}, /* M */
+  {0, 127, 6, 8, 48, 127, 0, 0}, /* N */
+  {0, 0, 127, 9, 9, 6, 0, 0}, /* P */
+  {0, 0, 38, 73, 73, 50, 0, 0}, /* S */
+  {0, 1, 1, 127, 1, 1, 0, 0}, /* T */
+  {0, 0, 48, 72, 40, 120, 0, 0}, /* a */
+  {0, 0, 127, 72, 72, 48, 0, 0}, /* b */
+  {0, 0, 48, 72, 72, 0, 0, 0}, /* c */
+  {0, 0, 48, 72, 72, 127, 0, 0}, /* d */
+  {0, 0, 48, 88, 88, 16, 0, 0}, /* e */
+  {0, 0, 126, 9, 1, 2, 0, 0}, /* f */
+  {0, 0, 80, 152, 152, 112, 0, 0}, /* g */
+  {0, 0, 127, 8, 8, 112, 0, 0}, /* h */
+  {0, 0, 0, 122, 0, 0, 0, 0}, /* i */
+  {0, 0, 64, 128, 128, 122, 0, 0}, /* j */
+  {0, 0, 127, 16, 40, 72, 0, 0}, /* k */
+  {0, 0, 0, 127, 0, 0, 0, 0}, /* l */
+  {0, 120, 8, 16, 8, 112, 0, 0}, /* m */
+  {0, 0, 120, 8, 8, 112, 0, 0}, /* n */
+  {0, 0, 48, 72, 72, 48, 0, 0}, /* o */
+  {0, 0, 248, 40, 40, 16, 0, 0}, /* p */
+  {0, 0, 112, 8, 8, 16, 0, 0}, /* r */
+  {0, 0, 72, 84, 84, 36, 0, 0}, /* s */
+  {0, 0, 8, 60, 72, 32, 0, 0}, /* t */
+  {0, 0, 56, 64, 32, 120, 0, 0}, /* u */
+  {0, 0, 56, 64, 56, 0, 0, 0}, /* v */
+  {0, 0, 72, 48, 48, 72, 0, 0}, /* x */
+  {0, 0, 24, 160, 160, 120, 0, 0}, /* y */
+  {0, 0, 100, 84, 84, 76, 0, 0}, /* z */
+  {0, 6, 9, 9, 6, 0, 0, 0}, /* 0xB0 */
+};
+
+/* 58 glyphs and the index, 720 bytes */
+const uint8_t font_map[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 1, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 3, 4, 5, 6,
+  7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 0, 0, 0, 0, 0,
+  0, 18, 19, 20, 21, 22, 23, 24, 25, 26, 0, 27, 0, 28, 29, 0,
+  30, 0, 0, 31, 32, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47,
+  48, 0, 49, 50, 51, 52, 53, 0, 54, 55, 56, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  57, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+/* 8 bytes, packed from 512 */
+const uint8_t splash_image[] = {
+  255, 255, 255, 255, 255, 255, 251, 255,
+};
+
+/* 292 bytes, packed from 512 */
+static const uint8_t screen0[] = {
+  5, 0, 127, 2, 4, 2, 127, 130, 0, 0, 48, 128, 88, 0, 16, 130,
+  0, 0, 120, 128, 8, 0, 112, 130, 0, 3, 56, 64, 32, 120, 131, 0,
+  0, 102, 220, 0, 0, 62, 128, 65, 0, 34, 130, 0, 0, 127, 128, 8,
+  0, 112, 130, 0, 0, 48, 128, 72, 0, 48, 130, 0, 0, 72, 128, 84,
+  0, 36, 130, 0, 0, 48, 128, 88, 0, 16, 138, 0, 3, 56, 64, 32,
+  120, 130, 0, 0, 120, 128, 8, 0, 112, 131, 0, 0, 122, 132, 0, 3,
+  8, 60, 72, 32, 177, 0, 4, 127, 2, 4, 2, 127, 130, 0, 0, 48,
+  128, 88, 0, 16, 130, 0, 3, 48, 72, 40, 120, 130, 0, 0, 72, 128,
+  84, 0, 36, 130, 0, 3, 56, 64, 32, 120, 130, 0, 0, 112, 128, 8,
+  0, 16, 132, 0, 0, 96, 138, 0, 128, 1, 0, 127, 128, 1, 130, 0,
+  0, 24, 128, 160, 0, 120, 130, 0, 0, 248, 128, 40, 0, 16, 130, 0,
+  0, 48, 128, 88, 0, 16, 162, 0, 0, 127, 128, 65, 0, 62, 131, 0,
+  0, 122, 132, 0, 0, 72, 128, 84, 0, 36, 130, 0, 0, 248, 128, 40,
+  0, 16, 131, 0, 0, 127, 132, 0, 3, 48, 72, 40, 120, 130, 0, 0,
+  24, 128, 160, 0, 120, 138, 0, 3, 8, 60, 72, 32, 130, 0, 0, 48,
+  128, 88, 0, 16, 129, 0, 4, 120, 8, 16, 8, 112, 130, 0, 0, 248,
+  128, 40, 0, 16, 130, 0, 0, 48, 128, 88, 0, 16, 130, 0, 0, 112,
+  128, 8, 0, 16, 130, 0, 3, 48, 72, 40, 120, 130, 0, 3, 8, 60,
+  72, 32, 128, 0,
+};
+
+/* 224 bytes, packed from 512 */
+static const uint8_t screen1[] = {
+  128, 0, 0, 62, 128, 65, 0, 34, 130, 0, 0, 48, 128, 88, 0, 16,
+  131, 0, 0, 127, 132, 0, 0, 48, 128, 72, 132, 0, 0, 122, 132, 0,
+  3, 56, 64, 32, 120, 130, 0, 0, 72, 128, 84, 0, 36, 202, 0, 3,
+  127, 8, 20, 99, 130, 0, 0, 48, 128, 88, 0, 16, 131, 0, 0, 127,
+  132, 0, 2, 56, 64, 56, 132, 0, 0, 122, 132, 0, 0, 120, 128, 8,
+  0, 112, 210, 0, 0, 127, 128, 9, 0, 1, 130, 0, 3, 48, 72, 40,
+  120, 130, 0, 0, 112, 128, 8, 0, 16, 130, 0, 0, 48, 128, 88, 0,
+  16, 130, 0, 0, 120, 128, 8, 0, 112, 130, 0, 0, 127, 128, 8, 0,
+  112, 130, 0, 0, 48, 128, 88, 0, 16, 131, 0, 0, 122, 132, 0, 3,
+  8, 60, 72, 32, 186, 0, 0, 127, 128, 73, 0, 54, 130, 0, 3, 48,
+  72, 40, 120, 130, 0, 0, 48, 128, 72, 131, 0, 3, 127, 16, 40, 72,
+  138, 0, 3, 8, 60, 72, 32, 130, 0, 0, 48, 128, 72, 0, 48, 137,
+  0, 4, 127, 2, 4, 2, 127, 130, 0, 0, 48, 128, 88, 0, 16, 130,
+  0, 0, 120, 128, 8, 0, 112, 130, 0, 3, 56, 64, 32, 120, 160, 0,
+};
+
+/* 292 bytes, packed from 512 */
+static const uint8_t screen2[] = {
+  128, 0, 0, 38, 128, 73, 0, 50, 130, 0, 0, 48, 128, 88, 0, 16,
+  130, 0, 3, 8, 60, 72, 32, 138, 0, 3, 8, 60, 72, 32, 131, 0,
+  0, 122, 131, 0, 4, 120, 8, 16, 8, 112, 130, 0, 0, 48, 128, 88,
+  0, 16, 130, 0, 0, 112, 128, 8, 0, 16, 186, 0, 0, 62, 128, 65,
+  0, 34, 130, 0, 0, 48, 128, 72, 0, 48, 130, 0, 0, 120, 128, 8,
+  0, 112, 130, 0, 3, 8, 60, 72, 32, 131, 0, 0, 122, 132, 0, 0,
+  120, 128, 8, 0, 112, 130, 0, 3, 56, 64, 32, 120, 130, 0, 0, 48,
+  128, 72, 0, 48, 130, 0, 3, 56, 64, 32, 120, 130, 0, 0, 72, 128,
+  84, 0, 36, 178, 0, 0, 126, 128, 9, 0, 126, 130, 0, 2, 56, 64,
+  56, 131, 0, 0, 48, 128, 88, 0, 16, 130, 0, 0, 112, 128, 8, 0,
+  16, 130, 0, 3, 48, 72, 40, 120, 130, 0, 0, 80, 128, 152, 0, 112,
+  130, 0, 0, 48, 128, 88, 0, 16, 138, 0, 3, 126, 9, 1, 2, 130,
+  0, 3, 56, 64, 32, 120, 130, 0, 0, 120, 128, 8, 0, 112, 130, 0,
+  0, 48, 128, 72, 133, 0, 0, 96, 155, 0, 0, 127, 128, 73, 0, 54,
+  130, 0, 3, 48, 72, 40, 120, 130, 0, 0, 48, 128, 72, 131, 0, 3,
+  127, 16, 40, 72, 138, 0, 3, 8, 60, 72, 32, 130, 0, 0, 48, 128,
+  72, 0, 48, 137, 0, 4, 127, 2, 4, 2, 127, 130, 0, 0, 48, 128,
+  88, 0, 16, 130, 0, 0, 120, 128, 8, 0, 112, 130, 0, 3, 56, 64,
+  32, 120, 160, 0,
+};
+
+/* 138 bytes, packed from 512 */
+static const uint8_t screen3[] = {
+  128, 0, 0, 38, 128, 73, 0, 50, 130, 0, 0, 48, 128, 88, 0, 16,
+  130, 0, 3, 8, 60, 72, 32, 138, 0, 3, 8, 60, 72, 32, 131, 0,
+  0, 122, 131, 0, 4, 120, 8, 16, 8, 112, 130, 0, 0, 48, 128, 88,
+  0, 16, 130, 0, 0, 112, 128, 8, 0, 16, 255, 0, 255, 0, 184, 0,
+  0, 127, 128, 73, 0, 54, 130, 0, 3, 48, 72, 40, 120, 130, 0, 0,
+  48, 128, 72, 131, 0, 3, 127, 16, 40, 72, 138, 0, 3, 8, 60, 72,
+  32, 130, 0, 0, 48, 128, 72, 0, 48, 137, 0, 4, 127, 2, 4, 2,
+  127, 130, 0, 0, 48, 128, 88, 0, 16, 130, 0, 0, 120, 128, 8, 0,
+  112, 130, 0, 3, 56, 64, 32, 120, 160, 0,
+};
+
+/* 4 screens in 946 bytes */
+const uint8_t *const screen_images[SCREEN_COUNT] = {
+  screen0, /* SCREEN_MENU */
+  screen1, /* SCREEN_UNIT */
+  screen2, /* SCREEN_TYPE */
+  screen3, /* SCREEN_TIMER */
+};
@@ -0,0 +1,363 @@
+/* mipslabchart.c
+   Temperature trend chart and histogram for the display.
+
+   For copyright and licensing, see file COPYING */
+
+#include <stdint.h>  /* Declarations of uint_32 and the like */
+#include <pic32mx.h> /* Declarations of system-specific addresses etc */
+#include "mipslab.h" /* Declatations for these labs */
+
+/* The chart uses the bottom three pages (rows 8 to 31), one column
+   per sample, newest at the right. Line 0 shows the range. */
+#define TREND_LEN 128
+#define TREND_PAGE 1
+#define TREND_PAGES 3
+#define TREND_TOP (TREND_PAGE * 8)
+#define TREND_BOTTOM 31
+
+/* One unit on the Y axis: whole degrees in sixteenths */
+#define TREND_STEP 16
+
+/* History, a ring of the last TREND_LEN samples */
+static int16_t trend_buf[TREND_LEN];
+static unsigned int trend_count;
+static int trend_active;
+
+/* Y range the chart is currently drawn with */
+static int trend_lo, trend_hi;
+
+/* Sliding-window minimum and maximum. Each queue holds ring positions
+   whose values are increasing (min) or decreasing (max) from front to
+   back, so the front is always the extreme of the window. Every sample
+   enters and leaves each queue once, so a push costs O(1) on average
+   instead of a rescan of the history. */
+struct trendq
+{
+  uint8_t pos[TREND_LEN];
+  int head;
+  int size;
+};
+
+static struct trendq trend_minq, trend_maxq;
+
+#define TRENDQ_AT(q, i) ((q)->pos[((q)->head + (i)) % TREND_LEN])
+
+/* Drop ring position pos from the front if it is about to be reused,
+   then push it at the back past every value it makes irrelevant.
+   sign is 1 for the min queue and -1 for the max queue. */
+static void trendq_push(struct trendq *q, int pos, int sign)
+{
+  int v = trend_buf[pos] * sign;
+
+  if (q->size > 0 && trend_count > TREND_LEN && TRENDQ_AT(q, 0) == pos)
+  {
+    q->head = (q->head + 1) % TREND_LEN;
+    q->size--;
+  }
+  while (q->size > 0 && trend_buf[TRENDQ_AT(q, q->size - 1)] * sign >= v)
+    q->size--;
+  TRENDQ_AT(q, q->size) = pos;
+  q->size++;
+}
+
+/* Row of a value in the current range; higher values nearer the top */
+static int trend_row(int value)
+{
+  return TREND_BOTTOM - (value - trend_lo) * (TREND_BOTTOM - TREND_TOP) /
+                            (trend_hi - trend_lo);
+}
+
+/* Build the column for sample n: a vertical stroke from the previous
+   sample's row to this one's, so the samples join up. The column is
+   a 32-bit word with bit r for row r, split into the chart pages. */
+static void trend_column(unsigned int n, uint8_t *column)
+{
+  int y0, y1, i;
+  uint32_t bits;
+
+  y1 = trend_row(trend_buf[n % TREND_LEN]);
+  y0 = n > 0 && n + TREND_LEN > trend_count ? trend_row(trend_buf[(n - 1) % TREND_LEN]) : y1;
+  if (y0 > y1)
+  {
+    i = y0;
+    y0 = y1;
+    y1 = i;
+  }
+  bits = (0xFFFFFFFF >> (31 - y1)) & (0xFFFFFFFF << y0);
+  for (i = 0; i < TREND_PAGES; i++)
+    column[i] = bits >> ((TREND_PAGE + i) * 8);
+}
+
+/* Show the range on line 0 */
+static void trend_label(void)
+{
+  display_printf(0, "%d..%d", trend_lo / TREND_STEP, trend_hi / TREND_STEP);
+}
+
+/* Redraw the whole chart, used when the range changes */
+static void trend_redraw(void)
+{
+  uint8_t column[TREND_PAGES];
+  unsigned int n, first;
+  int x;
+
+  display_fill_rect(0, TREND_TOP, 128, TREND_BOTTOM - TREND_TOP + 1, 0);
+  first = trend_count > TREND_LEN ? trend_count - TREND_LEN : 0;
+  x = 128 - (trend_count - first);
+  for (n = first; n < trend_count; n++, x++)
+  {
+    trend_column(n, column);
+    display_bitmap(x, 1, TREND_PAGE, TREND_PAGES, column, 0);
+  }
+  trend_label();
+  display_update();
+}
+
+/* trend_push:
+   Add a sample to the chart. The Y range follows the minimum and
+   maximum of the samples on screen, rounded out to whole degrees.
+   While it stays the same a sample costs one hardware scroll and one
+   column; only a change of range redraws the chart. */
+void trend_push(int value)
+{
+  int pos = trend_count % TREND_LEN;
+  int lo, hi;
+  uint8_t column[TREND_PAGES];
+
+  if (!trend_active)
+  {
+    trend_active = 1;
+    trend_count = 0;
+    trend_minq.size = trend_minq.head = 0;
+    trend_maxq.size = trend_maxq.head = 0;
+    trend_lo = trend_hi = 0;
+    /* Blank the text under the chart first, or it would be
+       rendered over the chart on the next update */
+    display_string(1, "");
+    display_string(2, "");
+    display_string(3, "");
+    display_render_text();
+  }
+
+  trend_buf[pos] = value;
+  trend_count++;
+  trendq_push(&trend_minq, pos, 1);
+  trendq_push(&trend_maxq, pos, -1);
+
+  lo = trend_buf[TRENDQ_AT(&trend_minq, 0)];
+  hi = trend_buf[TRENDQ_AT(&trend_maxq, 0)];
+  /* Round down and up to whole degrees, at least one degree apart */
+  lo = (lo >= 0 ? lo : lo - TREND_STEP + 1) / TREND_STEP * TREND_STEP;
+  hi = (hi >= 0 ? hi + TREND_STEP - 1 : hi) / TREND_STEP * TREND_STEP;
+  if (hi == lo)
+    hi = lo + TREND_STEP;
+
+  if (lo != trend_lo || hi != trend_hi || trend_count == 1)
+  {
+    trend_lo = lo;
+    trend_hi = hi;
+    trend_redraw();
+    return;
+  }
+  trend_column(trend_count - 1, column);
+  display_scroll_column(TREND_PAGE, TREND_PAGES, column);
+}
+
+/* trend_end:
+   Leave the chart and give the display back to the text lines. */
+void trend_end(void)
+{
+  if (!trend_active)
+    return;
+  trend_active = 0;
+  display_fill_rect(0, 0, 128, 32, 0);
+  display_text_invalidate();
+}
+
+/* Histogram of the readings in an averaging window, one bin per
+   sixteenth of a degree, the sensor's finest step. Bins count from
+   hist_base, half the bins below the first sample; a sample outside
+   that goes in the end bin. Bars use the same pages as the chart. */
+#define HIST_BINS 256
+#define HIST_PAGE TREND_PAGE
+#define HIST_PAGES TREND_PAGES
+#define HIST_HEIGHT (HIST_PAGES * 8)
+
+static uint16_t hist_bins[HIST_BINS];
+static int hist_base;
+
+/* Statistics of the window, kept as samples arrive */
+static int hist_n, hist_sum, hist_min, hist_max;
+
+/* Bins the histogram is zoomed to, and the count a full-height bar
+   stands for. The scale is a power of two, so it changes seldom. */
+static int hist_lo, hist_hi, hist_scale;
+static int hist_visible;
+
+static int hist_bin(int value)
+{
+  int b = value - hist_base;
+
+  if (b < 0)
+    return 0;
+  if (b >= HIST_BINS)
+    return HIST_BINS - 1;
+  return b;
+}
+
+/* Column of bin b when there are more bins than columns */
+#define HIST_COLUMN(b, span) (((b) - hist_lo) * 128 / (span))
+
+/* Draw the bar bin b is in. While the zoomed range fits in 128
+   columns each bin gets a bar of equal width; beyond that, bins
+   share a column and the bar shows their total. Returns the count
+   the bar shows. */
+static int hist_draw(int b, int draw)
+{
+  int span = hist_hi - hist_lo + 1;
+  int x0, x1, count, h, i;
+  uint32_t bits;
+  uint8_t column[HIST_PAGES];
+
+  if (span <= 128)
+  {
+    x0 = (b - hist_lo) * 128 / span;
+    x1 = (b - hist_lo + 1) * 128 / span;
+    count = hist_bins[b];
+  }
+  else
+  {
+    x0 = HIST_COLUMN(b, span);
+    x1 = x0 + 1;
+    while (b > hist_lo && HIST_COLUMN(b - 1, span) == x0)
+      b--;
+    for (count = 0; b <= hist_hi && HIST_COLUMN(b, span) == x0; b++)
+      count += hist_bins[b];
+  }
+  if (!draw)
+    return count;
+
+  h = count * HIST_HEIGHT / hist_scale;
+  if (count > 0 && h == 0)
+    h = 1;
+  bits = h ? 0xFFFFFFFF << (32 - h) : 0;
+  for (i = 0; i < HIST_PAGES; i++)
+    column[i] = bits >> ((HIST_PAGE + i) * 8);
+  for (; x0 < x1; x0++)
+    display_bitmap(x0, 1, HIST_PAGE, HIST_PAGES, column, 0);
+  return count;
+}
+
+/* Redraw every bar, used when the range or the scale changes */
+static void hist_redraw(void)
+{
+  int b, count, peak = 1;
+
+  for (b = hist_lo; b <= hist_hi; b++)
+  {
+    count = hist_draw(b, 0);
+    if (count > peak)
+      peak = count;
+  }
+  for (hist_scale = 1; hist_scale < peak; hist_scale <<= 1)
+    ;
+  display_fill_rect(0, HIST_PAGE * 8, 128, HIST_HEIGHT, 0);
+  for (b = hist_lo; b <= hist_hi; b++)
+    hist_draw(b, 1);
+}
+
+/* hist_start:
+   Start a new window with an empty histogram. */
+void hist_start(void)
+{
+  int i;
+
+  for (i = 0; i < HIST_BINS; i++)
+    hist_bins[i] = 0;
+  hist_n = hist_sum = 0;
+  hist_min = hist_max = 0;
+  if (hist_visible)
+    display_fill_rect(0, HIST_PAGE * 8, 128, HIST_HEIGHT, 0);
+}
+
+/* hist_show:
+   Show the histogram from now on, over text lines 1 to 3. */
+void hist_show(void)
+{
+  if (hist_visible)
+    return;
+  hist_visible = 1;
+  /* Blank the text under the bars first, or it would be rendered
+     over them on the next update */
+  display_string(1, "");
+  display_string(2, "");
+  display_string(3, "");
+  display_render_text();
+  display_fill_rect(0, HIST_PAGE * 8, 128, HIST_HEIGHT, 0);
+  if (hist_n > 0)
+    hist_redraw();
+}
+
+/* hist_add:
+   Add a sample, in sixteenths of a degree. The statistics and the
+   sample's bin are updated. If the histogram is shown, only the bar
+   for that bin is drawn again, unless the occupied range or the
+   scale changes. */
+void hist_add(int value)
+{
+  int b, lo, hi;
+
+  if (hist_n == 0)
+  {
+    hist_base = value - HIST_BINS / 2;
+    hist_min = hist_max = value;
+    hist_lo = hist_hi = -1;
+  }
+  b = hist_bin(value);
+  hist_bins[b]++;
+  hist_n++;
+  hist_sum += value;
+  if (value < hist_min)
+    hist_min = value;
+  if (value > hist_max)
+    hist_max = value;
+
+  lo = hist_bin(hist_min);
+  hi = hist_bin(hist_max);
+  if (lo != hist_lo || hi != hist_hi)
+  {
+    hist_lo = lo;
+    hist_hi = hi;
+    if (hist_visible)
+      hist_redraw();
+  }
+  else if (!hist_visible)
+    return;
+  else if (hist_draw(b, 0) > hist_scale)
+    hist_redraw();
+  else
+    hist_draw(b, 1);
+}
+
+/* hist_stats:
+   Number of samples in the window, and their minimum, maximum and
+   sum in sixteenths of a degree. */
+void hist_stats(int *n, int *min, int *max, int *sum)
+{
+  *n = hist_n;
+  *min = hist_min;
+  *max = hist_max;
+  *sum = hist_sum;
+}
+
+/* hist_end:
+   Remove the histogram and give its pages back to the text lines.
+   The window's statistics are kept. */
+void hist_end(void)
+{
+  if (!hist_visible)
+    return;
+  hist_visible = 0;
+  display_fill_rect(0, HIST_PAGE * 8, 128, HIST_HEIGHT, 0);
+  display_text_invalidate();
+}
@@ -5,6 +5,7 @@
    For copyright and licensing, see file COPYING */
 
 #include <stdint.h>  /* Declarations of uint_32 and the like */
+#include <stdarg.h>  /* Declarations of va_list and the like */
 #include <pic32mx.h> /* Declarations of system-specific addresses etc */
 #include "mipslab.h" /* Declatations for these labs */
 
@@ -23,6 +24,30 @@ static void num32asc(char *s, int);
 #define DISPLAY_TURN_OFF_VDD (PORTFSET = 0x40)
 #define DISPLAY_TURN_OFF_VBAT (PORTFSET = 0x20)
 
+/* Interrupt bits for SPI2 TX: IRQ 38 in IFS1/IEC1,
+   vector 31 with its priority in IPC7<28:26> */
+#define SPI2TX_IRQ_MASK (1 << 6)
+#define SPI2_IPC_SHIFT 26
+#define SPI2_PRIORITY 3
+
+/* SPI2STAT bits, as they read with the enhanced buffer enabled */
+#define SPI2STAT_SPIRBF 0x01 /* RX FIFO full */
+#define SPI2STAT_SPITBF 0x02 /* TX FIFO full */
+#define SPI2STAT_SPITBE 0x08 /* TX FIFO empty */
+#define SPI2STAT_SPIRBE 0x20 /* RX FIFO empty */
+#define SPI2STAT_SPIROV 0x40
+#define SPI2STAT_SRMT 0x80 /* Shift register empty */
+#define SPI2STAT_SPIBUSY 0x800
+
+/* SPI2CON bits */
+#define SPI2CON_MODE32 0x800
+#define SPI2CON_ON 0x8000
+
+/* Word-aligned runs at least this long are sent in 32-bit mode.
+   Switching mode means draining the FIFO and cycling ON,
+   which does not pay off for short runs. */
+#define SPI_BURST32_MIN 32
+
 // #define DISPLAY_COMMAND_DATA_PORT PORTF // added
 // #define DISPLAY_COMMAND_DATA_MASK 0x10  // added
 
@@ -37,6 +62,16 @@ void quicksleep(int cyc)
     ;
 }
 
+/* delay_us:
+   Wait us microseconds, timed by the core timer. */
+void delay_us(unsigned int us)
+{
+  unsigned int t0 = core_timer();
+
+  while (core_timer() - t0 < us * (CORE_TIMER_HZ / 1000000))
+    ;
+}
+
 /* tick:
    Add 1 to time in memory, at location pointed to by parameter.
    Time is stored as 4 pairs of 2 NBCD-digits.
@@ -89,9 +124,9 @@ void tick(unsigned int *timep)
 
    There's one parameter: the address to read and display.
 
-   Note: When you use this function, you should comment out any
-   repeated calls to display_image; display_image overwrites
-   about half of the digits shown by display_debug.
+   Note: Text and images share one framebuffer, and whatever is
+   drawn last over a cell is what shows. A display_image call after
+   display_debug still hides about half of its digits.
 */
 void display_debug(volatile int *const addr)
 {
@@ -104,111 +139,1191 @@ void display_debug(volatile int *const addr)
 
 uint8_t spi_send_recv(uint8_t data)
 {
-  while (!(SPI2STAT & 0x08))
+  while (SPI2STAT & SPI2STAT_SPITBF)
     ;
   SPI2BUF = data;
-  while (!(SPI2STAT & 1))
+  while (SPI2STAT & SPI2STAT_SPIRBE)
     ;
   return SPI2BUF;
 }
 
-void display_init(void)
+/* Wait until every queued byte has left the shift register,
+   then throw away whatever the display clocked back */
+static void spi_wait_idle(void)
+{
+  while ((SPI2STAT & (SPI2STAT_SPITBE | SPI2STAT_SRMT)) !=
+         (SPI2STAT_SPITBE | SPI2STAT_SRMT))
+    ;
+  while (!(SPI2STAT & SPI2STAT_SPIRBE))
+    (void)SPI2BUF;
+  SPI2STATCLR = SPI2STAT_SPIROV;
+}
+
+/* Switch between 8- and 32-bit transfers; only allowed while SPI2 is off */
+static void spi_set_mode32(int on)
+{
+  spi_wait_idle();
+  SPI2CONCLR = SPI2CON_ON;
+  if (on)
+    SPI2CONSET = SPI2CON_MODE32;
+  else
+    SPI2CONCLR = SPI2CON_MODE32;
+  SPI2CONSET = SPI2CON_ON;
+}
+
+/* Push bytes into the TX FIFO as fast as it accepts them.
+   The RX FIFO is emptied on the way so it never overflows. */
+static void spi_fifo_bytes(const uint8_t *p, int len, uint8_t invert)
+{
+  unsigned int stat;
+
+  while (len > 0)
+  {
+    stat = SPI2STAT;
+    if (!(stat & SPI2STAT_SPIRBE))
+      (void)SPI2BUF;
+    if (stat & SPI2STAT_SPITBF)
+      continue;
+    SPI2BUF = *p++ ^ invert;
+    len--;
+  }
+}
+
+/* Same, a 32-bit word at a time. SPI shifts the most significant
+   bit first, so the bytes are swapped to keep their memory order. */
+static void spi_fifo_words(const uint32_t *p, int n, uint32_t invert)
+{
+  unsigned int stat;
+
+  while (n > 0)
+  {
+    stat = SPI2STAT;
+    if (!(stat & SPI2STAT_SPIRBE))
+      (void)SPI2BUF;
+    if (stat & SPI2STAT_SPITBF)
+      continue;
+    SPI2BUF = __builtin_bswap32(*p++) ^ invert;
+    n--;
+  }
+}
+
+/* Queue len bytes on SPI2 without waiting for them to go out.
+   Bytes stream through the 16-byte enhanced-buffer FIFO, and the
+   word-aligned middle of long runs goes out in 32-bit mode. */
+static void spi_stream(const uint8_t *p, int len, int invert)
+{
+  int n = len;
+  uint8_t mask = invert ? 0xFF : 0;
+
+  if (len >= SPI_BURST32_MIN)
+    n = (4 - ((uintptr_t)p & 3)) & 3;
+  spi_fifo_bytes(p, n, mask);
+  p += n;
+  len -= n;
+
+  if (len >= 4)
+  {
+    n = len >> 2;
+    spi_set_mode32(1);
+    spi_fifo_words((const uint32_t *)p, n, invert ? 0xFFFFFFFF : 0);
+    spi_set_mode32(0);
+    p += n << 2;
+    len &= 3;
+  }
+  spi_fifo_bytes(p, len, mask);
+}
+
+/* spi_send_burst:
+   Send len bytes without waiting for a byte back after each one.
+   Returns when the last byte is on the wire, so D/C may change. */
+void spi_send_burst(const uint8_t *p, int len, int invert)
+{
+  spi_stream(p, len, invert);
+  spi_wait_idle();
+}
+
+/* Display power-up, as a table of steps. Each step does one thing
+   and then leaves delay_us microseconds before the next; the times
+   are the minimums from the SSD1306 and Basic I/O Shield datasheets.
+   The steps are run by display_init_poll against the core timer, so
+   other set-up can go on in the waits. */
+#define INIT_CMD 0   /* Send arg as a command byte */
+#define INIT_VDD 1   /* Switch on the logic supply */
+#define INIT_VBAT 2  /* Switch on the panel supply */
+#define INIT_RESET 3 /* Hold the controller in reset */
+#define INIT_RUN 4   /* Release it */
+
+struct init_step
+{
+  uint8_t op;
+  uint8_t arg;
+  uint32_t delay_us;
+};
+
+static const struct init_step display_init_steps[] = {
+    {INIT_VDD, 0, 1000},    /* VDD settles in 1 ms */
+    {INIT_CMD, 0xAE, 0},    /* Display off */
+    {INIT_RESET, 0, 3},     /* Reset pulse of at least 3 us */
+    {INIT_RUN, 0, 3},       /* Controller ready 3 us after reset */
+    {INIT_CMD, 0x8D, 0},    /* Charge pump on */
+    {INIT_CMD, 0x14, 0},
+    {INIT_CMD, 0xD9, 0},    /* Pre-charge period */
+    {INIT_CMD, 0xF1, 0},
+    {INIT_VBAT, 0, 100000}, /* VBAT settles in 100 ms */
+    {INIT_CMD, 0xA1, 0},    /* Column 0 at the left */
+    {INIT_CMD, 0xC8, 0},    /* Row 0 at the top */
+    {INIT_CMD, 0xDA, 0},    /* COM pins as the panel is wired */
+    {INIT_CMD, 0x20, 0},
+    /* Horizontal addressing: data fills the column/page window set by
+       0x21/0x22 left to right, then wraps to the next page, so any
+       rectangle goes out as one data burst */
+    {INIT_CMD, 0x20, 0},
+    {INIT_CMD, 0x00, 0},
+    /* No hardware scroll running and RAM row 0 at the top; the trend
+       chart relies on both before it scrolls with 0x2D */
+    {INIT_CMD, 0x2E, 0},
+    {INIT_CMD, 0x40, 0},
+    {INIT_CMD, 0xAF, 0}, /* Display on */
+};
+
+#define INIT_STEPS (int)(sizeof(display_init_steps) / sizeof(display_init_steps[0]))
+
+/* Next step to run, and the core timer value it may run at. -1
+   until display_init_start, INIT_STEPS + 1 once the display is up. */
+static int init_next = -1;
+static unsigned int init_deadline;
+
+/* display_init_start:
+   Start powering up the display: VDD goes on here, so its settle
+   window runs from now. Call display_init_poll between other set-up
+   steps, and until it returns 1 before drawing anything. */
+void display_init_start(void)
 {
   DISPLAY_CHANGE_TO_COMMAND_MODE;
-  quicksleep(10);
-  DISPLAY_ACTIVATE_VDD;
-  quicksleep(1000000);
+  init_next = 0;
+  init_deadline = core_timer();
+  display_init_poll();
+}
 
-  spi_send_recv(0xAE);
-  DISPLAY_ACTIVATE_RESET;
-  quicksleep(10);
-  DISPLAY_DO_NOT_RESET;
-  quicksleep(10);
+/* display_init_poll:
+   Run the power-up steps that are due. Returns 1 once the display
+   is ready, 0 while it is still waiting out a delay or has not
+   been started. */
+int display_init_poll(void)
+{
+  const struct init_step *st;
 
-  spi_send_recv(0x8D);
-  spi_send_recv(0x14);
+  if (init_next < 0)
+    return 0;
+  while (init_next < INIT_STEPS)
+  {
+    if ((int)(core_timer() - init_deadline) < 0)
+      return 0;
+    st = &display_init_steps[init_next++];
+    switch (st->op)
+    {
+    case INIT_CMD:
+      spi_send_recv(st->arg);
+      break;
+    case INIT_VDD:
+      DISPLAY_ACTIVATE_VDD;
+      break;
+    case INIT_VBAT:
+      DISPLAY_ACTIVATE_VBAT;
+      break;
+    case INIT_RESET:
+      DISPLAY_ACTIVATE_RESET;
+      break;
+    case INIT_RUN:
+      DISPLAY_DO_NOT_RESET;
+      break;
+    }
+    init_deadline = core_timer() + st->delay_us * (CORE_TIMER_HZ / 1000000);
+  }
 
-  spi_send_recv(0xD9);
-  spi_send_recv(0xF1);
+  if (init_next == INIT_STEPS)
+  {
+    init_next++;
+    /* Priority for the SPI2 interrupt that drives display_update_async */
+    IPCCLR(7) = 0x1F << 24;
+    IPCSET(7) = SPI2_PRIORITY << SPI2_IPC_SHIFT;
 
-  DISPLAY_ACTIVATE_VBAT;
-  quicksleep(10000000);
+    /* Whatever is in display RAM now, it is not our frame */
+    display_invalidate();
+  }
+  return 1;
+}
 
-  spi_send_recv(0xA1);
-  spi_send_recv(0xC8);
+/* display_init:
+   Power up the display, waiting for it. */
+void display_init(void)
+{
+  display_init_start();
+  while (!display_init_poll())
+    ;
+}
 
-  spi_send_recv(0xDA);
-  spi_send_recv(0x20);
+/* Fill a text line with spaces, a word at a time */
+static void text_clear(int line)
+{
+  uint32_t *w = (uint32_t *)textbuffer[line];
 
-  spi_send_recv(0xAF);
+  w[0] = w[1] = w[2] = w[3] = 0x20202020;
 }
 
 void display_string(int line, char *s)
 {
-  int i;
+  char *d;
   if (line < 0 || line >= 4)
     return;
   if (!s)
     return;
 
-  for (i = 0; i < 16; i++)
-    if (*s)
+  text_clear(line);
+  for (d = textbuffer[line]; *s && d < textbuffer[line] + 16; s++)
+    *d++ = *s;
+}
+
+/* Field flags for format_number */
+#define FMT_LEFT 1 /* '-': pad on the right */
+#define FMT_ZERO 2 /* '0': pad with zeros after the sign */
+
+/* Write v in base, with a minus sign if neg, right-aligned in width
+   characters at p. Nothing is written at or past end. The digits go
+   straight to their place, last first, so no buffer is needed.
+   Returns the position after the field. */
+static char *format_number(char *p, char *end, unsigned int v, unsigned int base,
+                           int neg, int width, int flags)
+{
+  unsigned int t;
+  int n = 1, pad;
+  char *q;
+
+  for (t = v; t >= base; t /= base)
+    n++;
+  pad = width - n - neg;
+  if (pad > 0 && !(flags & (FMT_LEFT | FMT_ZERO)))
+    for (; pad > 0; pad--, p++)
+      if (p < end)
+        *p = ' ';
+  if (neg && p < end)
+    *p = '-';
+  p += neg;
+  if (pad > 0 && (flags & FMT_ZERO))
+    for (; pad > 0; pad--, p++)
+      if (p < end)
+        *p = '0';
+  for (q = p + n - 1; q >= p; q--, v /= base)
+    if (q < end)
+      *q = "0123456789ABCDEF"[v % base];
+  p += n;
+  for (; pad > 0; pad--, p++)
+    if (p < end)
+      *p = ' ';
+  return p;
+}
+
+/* Write s at p, padded to width on the side flags say. Nothing is
+   written at or past end. Returns the position after the field. */
+static char *format_field(char *p, char *end, const char *s, int width, int flags)
+{
+  int n;
+
+  for (n = 0; s[n]; n++)
+    ;
+  if (!(flags & FMT_LEFT))
+    for (; width > n; width--, p++)
+      if (p < end)
+        *p = ' ';
+  for (; *s; s++, p++, width--)
+    if (p < end)
+      *p = *s;
+  for (; width > 0; width--, p++)
+    if (p < end)
+      *p = ' ';
+  return p;
+}
+
+/* Format into p up to end, printf style. Takes %d, %u, %x (in
+   capitals), %c, %s, %f and %%, with the '-' and '0' flags, a field
+   width and, for %f, a precision (default 1, halves rounded up).
+   A %f too large for 32 bits of fixed point comes out as "ovf".
+   Returns the position after the output, which may be past end when
+   it was cut off. */
+static char *format_text(char *p, char *end, const char *fmt, va_list ap)
+{
+  char *start;
+  unsigned int v, scale;
+  int flags, width, prec, i;
+  double f;
+
+  for (; *fmt; fmt++)
+  {
+    if (*fmt != '%')
+    {
+      if (p < end)
+        *p = *fmt;
+      p++;
+      continue;
+    }
+
+    flags = 0;
+    for (fmt++; *fmt == '-' || *fmt == '0'; fmt++)
+      flags |= *fmt == '-' ? FMT_LEFT : FMT_ZERO;
+    for (width = 0; *fmt >= '0' && *fmt <= '9'; fmt++)
+      width = width * 10 + *fmt - '0';
+    prec = 1;
+    if (*fmt == '.')
+      for (prec = 0, fmt++; *fmt >= '0' && *fmt <= '9'; fmt++)
+        prec = prec * 10 + *fmt - '0';
+
+    switch (*fmt)
     {
-      textbuffer[line][i] = *s;
-      s++;
+    case 'd':
+      /* Negate as unsigned, so INT_MIN comes out right */
+      i = va_arg(ap, int);
+      v = i < 0 ? 0u - (unsigned int)i : (unsigned int)i;
+      p = format_number(p, end, v, 10, i < 0, width, flags);
+      break;
+    case 'u':
+      p = format_number(p, end, va_arg(ap, unsigned int), 10, 0, width, flags);
+      break;
+    case 'x':
+      p = format_number(p, end, va_arg(ap, unsigned int), 16, 0, width, flags);
+      break;
+    case 'f':
+      /* Round to prec decimals in fixed point, then write the whole
+         part and the fraction as two numbers */
+      f = va_arg(ap, double);
+      for (scale = 1, i = 0; i < prec; i++)
+        scale *= 10;
+      /* Written so that a NaN fails it too */
+      if (!((f < 0 ? -f : f) * scale + 0.5 < 4294967296.0))
+      {
+        p = format_field(p, end, "ovf", width, flags);
+        break;
+      }
+      v = (f < 0 ? -f : f) * scale + 0.5;
+      start = p;
+      p = format_number(p, end, v / scale, 10, f < 0 && v != 0,
+                        flags & FMT_LEFT ? 0 : prec ? width - prec - 1 : width, flags);
+      if (prec)
+      {
+        if (p < end)
+          *p = '.';
+        p = format_number(p + 1, end, v % scale, 10, 0, prec, FMT_ZERO);
+      }
+      for (; p - start < width; p++)
+        if (p < end)
+          *p = ' ';
+      break;
+    case 'c':
+      if (p < end)
+        *p = va_arg(ap, int);
+      p++;
+      break;
+    case 's':
+      p = format_field(p, end, va_arg(ap, const char *), width, flags);
+      break;
+    case '%':
+      if (p < end)
+        *p = '%';
+      p++;
+      break;
+    default:
+      return p;
     }
-    else
-      textbuffer[line][i] = ' ';
+  }
+  return p;
 }
 
-void display_image(int x, const uint8_t *data)
+/* display_printf:
+   Format straight into text line 'line', printf style, and blank the
+   rest of it. See format_text for what fmt can hold; output past the
+   16th character is dropped. Returns the number of characters the
+   output would have taken. */
+int display_printf(int line, const char *fmt, ...)
 {
-  int i, j;
+  va_list ap;
+  char *end;
 
-  for (i = 0; i < 4; i++)
+  if (line < 0 || line >= 4)
+    return 0;
+  text_clear(line);
+  va_start(ap, fmt);
+  end = format_text(textbuffer[line], textbuffer[line] + 16, fmt, ap);
+  va_end(ap);
+  return end - textbuffer[line];
+}
+
+/* format_string:
+   Format into dst, printf style like display_printf, writing at most
+   size characters with the terminating zero. Returns the number of
+   characters the output would have taken, or 0 if size is 0 and
+   nothing is written. */
+int format_string(char *dst, int size, const char *fmt, ...)
+{
+  va_list ap;
+  char *end;
+
+  if (size <= 0)
+    return 0;
+  va_start(ap, fmt);
+  end = format_text(dst, dst + size - 1, fmt, ap);
+  va_end(ap);
+  *(end < dst + size - 1 ? end : dst + size - 1) = 0;
+  return end - dst;
+}
+
+/* Display transfers are queued as segments: runs of bytes that are
+   sent with the D/C line in one state. The same queue is drained
+   either by polling (spi_run_queue) or by the SPI2 TX interrupt
+   (display_isr), so both paths send exactly the same bytes. */
+#define SPI_SEG_DATA 1   /* D/C high: bytes go to display RAM */
+#define SPI_SEG_INVERT 2 /* Send the complement of every byte */
+
+/* Worst case frame: a window and a data segment per page */
+#define SPI_SEG_MAX 8
+#define SPI_CMD_MAX 24
+
+struct spiseg
+{
+  const uint8_t *p;
+  uint16_t len;
+  uint8_t flags;
+};
+
+static struct spiseg spiseg[SPI_SEG_MAX];
+static uint8_t spicmd[SPI_CMD_MAX];
+static int spiseg_count;
+static int spicmd_count;
+
+/* Progress of an interrupt-driven flush */
+static volatile int spiseg_pos;
+static volatile int spibyte_pos;
+static volatile int spi_busy;
+
+static void spi_queue_reset(void)
+{
+  spiseg_count = 0;
+  spicmd_count = 0;
+}
+
+/* Append bytes to the queue, growing the last segment
+   when the new bytes directly follow it */
+static void spi_queue(const uint8_t *p, int len, int flags)
+{
+  struct spiseg *seg;
+
+  if (spiseg_count > 0)
   {
-    DISPLAY_CHANGE_TO_COMMAND_MODE;
+    seg = &spiseg[spiseg_count - 1];
+    if (seg->flags == flags && seg->p + seg->len == p)
+    {
+      seg->len += len;
+      return;
+    }
+  }
+  seg = &spiseg[spiseg_count++];
+  seg->p = p;
+  seg->len = len;
+  seg->flags = flags;
+}
+
+static void spi_queue_cmd(uint8_t cmd)
+{
+  spicmd[spicmd_count] = cmd;
+  spi_queue(&spicmd[spicmd_count++], 1, 0);
+}
+
+/* Bytes a window preamble costs */
+#define DISPLAY_WINDOW_BYTES 6
+
+/* Queue the column (0x21) and page (0x22) address window that the
+   following data fills in horizontal addressing mode */
+static void spi_queue_window(int x, int w, int page, int pages)
+{
+  spi_queue_cmd(0x21);
+  spi_queue_cmd(x);
+  spi_queue_cmd(x + w - 1);
+
+  spi_queue_cmd(0x22);
+  spi_queue_cmd(page);
+  spi_queue_cmd(page + pages - 1);
+}
+
+/* Send the whole queue. Segments with the same D/C state follow each
+   other through the FIFO without a pause; the line is only switched
+   once the previous bytes have left the shift register. */
+static void spi_run_queue(void)
+{
+  int i;
+  const struct spiseg *seg;
+
+  for (i = 0; i < spiseg_count; i++)
+  {
+    seg = &spiseg[i];
+    if (i == 0 || ((seg->flags ^ seg[-1].flags) & SPI_SEG_DATA))
+    {
+      spi_wait_idle();
+      if (seg->flags & SPI_SEG_DATA)
+        DISPLAY_CHANGE_TO_DATA_MODE;
+      else
+        DISPLAY_CHANGE_TO_COMMAND_MODE;
+    }
+    spi_stream(seg->p, seg->len, seg->flags & SPI_SEG_INVERT);
+  }
+  spi_wait_idle();
+}
+
+/* display_flush_done:
+   Returns 1 when no interrupt-driven flush is in progress. */
+int display_flush_done(void)
+{
+  return !spi_busy;
+}
 
-    spi_send_recv(0x22);
-    spi_send_recv(i);
+/* Wait for an interrupt-driven flush to finish
+   before the queue is reused */
+static void display_flush_wait(void)
+{
+  while (spi_busy)
+    ;
+}
 
-    spi_send_recv(x & 0xF);
-    spi_send_recv(0x10 | ((x >> 4) & 0xF));
+/* Start draining the queue from the SPI2 TX interrupt */
+static void spi_start_queue(void)
+{
+  if (spiseg_count == 0)
+    return;
 
+  spiseg_pos = 0;
+  spibyte_pos = 0;
+  spi_busy = 1;
+  if (spiseg[0].flags & SPI_SEG_DATA)
     DISPLAY_CHANGE_TO_DATA_MODE;
+  else
+    DISPLAY_CHANGE_TO_COMMAND_MODE;
 
-    for (j = 0; j < 32; j++)
-      spi_send_recv(~data[i * 32 + j]);
+  /* The TX FIFO is empty, so the flag is raised as soon as
+     the interrupt is enabled and display_isr starts filling it */
+  IECSET(1) = SPI2TX_IRQ_MASK;
+}
+
+/* display_isr:
+   SPI2 TX interrupt handler, called from user_isr.
+   SPI2 raises the interrupt when its TX FIFO has run empty;
+   each call refills the FIFO from the queue. */
+void display_isr(void)
+{
+  const struct spiseg *seg = &spiseg[spiseg_pos];
+  int pos = spibyte_pos;
+  uint8_t invert = (seg->flags & SPI_SEG_INVERT) ? 0xFF : 0;
+
+  /* Nobody reads the display; drop the received bytes */
+  while (!(SPI2STAT & SPI2STAT_SPIRBE))
+    (void)SPI2BUF;
+
+  while (!(SPI2STAT & SPI2STAT_SPITBF))
+  {
+    if (pos == seg->len)
+    {
+      if (spiseg_pos + 1 == spiseg_count)
+      {
+        /* Let the last byte finish so the next transfer may change D/C */
+        spi_wait_idle();
+        IECCLR(1) = SPI2TX_IRQ_MASK;
+        IFSCLR(1) = SPI2TX_IRQ_MASK;
+        spi_busy = 0;
+        return;
+      }
+      if ((seg[1].flags ^ seg->flags) & SPI_SEG_DATA)
+      {
+        /* D/C may only change once the FIFO and shift register are empty.
+           Come back when the FIFO has run dry; from there it is at most
+           one byte time until the shift register is done. */
+        if (!(SPI2STAT & SPI2STAT_SPITBE))
+          break;
+        while (!(SPI2STAT & SPI2STAT_SRMT))
+          ;
+        if (seg[1].flags & SPI_SEG_DATA)
+          DISPLAY_CHANGE_TO_DATA_MODE;
+        else
+          DISPLAY_CHANGE_TO_COMMAND_MODE;
+      }
+      spiseg_pos++;
+      seg++;
+      pos = 0;
+      invert = (seg->flags & SPI_SEG_INVERT) ? 0xFF : 0;
+    }
+    SPI2BUF = seg->p[pos++] ^ invert;
   }
+
+  spibyte_pos = pos;
+  IFSCLR(1) = SPI2TX_IRQ_MASK;
 }
 
-void display_update(void)
+/* Bytes and rounds sent by display_benchmark for each path */
+#define BENCH_BYTES 512
+#define BENCH_ROUNDS 8
+
+/* Bytes per second for BENCH_ROUNDS rounds sent in the given
+   core timer ticks, scaled to stay inside 32 bits */
+static unsigned int bench_rate(unsigned int ticks)
 {
-  int i, j, k;
-  int c;
+  if (ticks == 0)
+    return 0;
+  return BENCH_BYTES * BENCH_ROUNDS * (CORE_TIMER_HZ / 1000) / ticks * 1000;
+}
+
+/* display_benchmark:
+   Stream a frame's worth of bytes to display RAM, first one byte
+   at a time through spi_send_recv and then through spi_send_burst,
+   and report the bytes per second of each path. The panel shows
+   garbage afterwards and is redrawn by the next display_update. */
+void display_benchmark(unsigned int *bps_byte, unsigned int *bps_burst)
+{
+  const uint8_t *src = (const uint8_t *)framebuffer;
+  int i, n;
+  unsigned int t0;
+
+  display_flush_wait();
+  DISPLAY_CHANGE_TO_DATA_MODE;
+
+  t0 = core_timer();
+  for (n = 0; n < BENCH_ROUNDS; n++)
+    for (i = 0; i < BENCH_BYTES; i++)
+      spi_send_recv(src[i]);
+  *bps_byte = bench_rate(core_timer() - t0);
+
+  t0 = core_timer();
+  for (n = 0; n < BENCH_ROUNDS; n++)
+    spi_send_burst(src, BENCH_BYTES, 0);
+  *bps_burst = bench_rate(core_timer() - t0);
+
+  display_invalidate();
+}
+
+/* Frames as they should appear on the panel, one byte per column
+   and page with bit 0 at the top, in the order horizontal addressing
+   sends it. Text, bitmaps and drawing primitives are all composited
+   into the back frame, framebuffer; the front frame is the one being
+   sent. display_update swaps them, so drawing never touches a frame
+   that SPI is reading and only display_update touches SPI. */
+static uint8_t frames[2][4][128] __attribute__((aligned(4)));
+uint8_t (*framebuffer)[128] = frames[0];
+static uint8_t (*display_front)[128] = frames[1];
+
+/* Columns of each page of the back frame that changed since the last
+   swap. A page is clean when fb_hi < fb_lo. */
+static uint8_t fb_lo[4];
+static int8_t fb_hi[4] = {-1, -1, -1, -1};
+
+/* The same for the front frame: what the current flush sends */
+static uint8_t send_lo[4];
+static int8_t send_hi[4];
+
+/* Shadow copy of textbuffer as last rendered into the framebuffer.
+   Only cells that differ from it, or whose bit is set in textforce,
+   are rasterized again. */
+static char textshadow[4][16] __attribute__((aligned(4)));
+static uint16_t textforce[4];
+
+/* SPI bytes a full redraw cost before dirty tracking:
+   4 pages of 4 command and 128 data bytes */
+#define DISPLAY_FULL_FRAME_BYTES (4 * (4 + 128))
+
+/* Bytes display_update did not have to send, last frame and in total */
+unsigned int display_bytes_saved;
+unsigned int display_bytes_saved_total;
+
+/* Mark columns x0 to x1 of a page as changed */
+static void fb_touch(int page, int x0, int x1)
+{
+  if (fb_hi[page] < fb_lo[page])
+  {
+    fb_lo[page] = x0;
+    fb_hi[page] = x1;
+    return;
+  }
+  if (x0 < fb_lo[page])
+    fb_lo[page] = x0;
+  if (x1 > fb_hi[page])
+    fb_hi[page] = x1;
+}
+
+/* display_invalidate:
+   Force the next display_update to resend the whole frame,
+   e.g. after something has written to display RAM behind our back. */
+void display_invalidate(void)
+{
+  int i;
   for (i = 0; i < 4; i++)
   {
-    DISPLAY_CHANGE_TO_COMMAND_MODE;
-    spi_send_recv(0x22);
-    spi_send_recv(i);
+    fb_lo[i] = 0;
+    fb_hi[i] = 127;
+  }
+}
 
-    spi_send_recv(0x0);
-    spi_send_recv(0x10);
+/* display_clear:
+   Clear the whole frame, a word at a time. */
+void display_clear(void)
+{
+  uint32_t *p = (uint32_t *)framebuffer;
+  int i;
 
-    DISPLAY_CHANGE_TO_DATA_MODE;
+  for (i = 0; i < sizeof(frames[0]) / 4; i++)
+    p[i] = 0;
+  display_invalidate();
+}
+
+/* display_pixel:
+   Set (on = 1) or clear (on = 0) the pixel at column x, row y. */
+void display_pixel(int x, int y, int on)
+{
+  uint8_t *b;
+
+  if (x < 0 || x >= 128 || y < 0 || y >= 32)
+    return;
+  b = &framebuffer[y >> 3][x];
+  if (on)
+    *b |= 1 << (y & 7);
+  else
+    *b &= ~(1 << (y & 7));
+  fb_touch(y >> 3, x, x);
+}
+
+/* display_line:
+   Draw a line from (x0, y0) to (x1, y1), Bresenham style. */
+void display_line(int x0, int y0, int x1, int y1, int on)
+{
+  int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+  int dy = y1 > y0 ? y0 - y1 : y1 - y0;
+  int sx = x0 < x1 ? 1 : -1;
+  int sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy, e2;
+
+  for (;;)
+  {
+    display_pixel(x0, y0, on);
+    if (x0 == x1 && y0 == y1)
+      break;
+    e2 = 2 * err;
+    if (e2 >= dy)
+    {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx)
+    {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+/* display_fill_rect:
+   Set or clear every pixel of a w by h rectangle. Works a page byte
+   at a time, masking the rows the rectangle covers in each page. */
+void display_fill_rect(int x, int y, int w, int h, int on)
+{
+  int page, i, x1, y1;
+  uint8_t mask;
+
+  x1 = x + w - 1;
+  y1 = y + h - 1;
+  if (x < 0)
+    x = 0;
+  if (y < 0)
+    y = 0;
+  if (x1 > 127)
+    x1 = 127;
+  if (y1 > 31)
+    y1 = 31;
+  if (x > x1 || y > y1)
+    return;
+
+  for (page = y >> 3; page <= y1 >> 3; page++)
+  {
+    mask = 0xFF;
+    if (page == y >> 3)
+      mask &= 0xFF << (y & 7);
+    if (page == y1 >> 3)
+      mask &= 0xFF >> (7 - (y1 & 7));
+    for (i = x; i <= x1; i++)
+      if (on)
+        framebuffer[page][i] |= mask;
+      else
+        framebuffer[page][i] &= ~mask;
+    fb_touch(page, x, x1);
+  }
+}
+
+/* display_rect:
+   Draw the outline of a w by h rectangle. */
+void display_rect(int x, int y, int w, int h, int on)
+{
+  display_fill_rect(x, y, w, 1, on);
+  display_fill_rect(x, y + h - 1, w, 1, on);
+  display_fill_rect(x, y, 1, h, on);
+  display_fill_rect(x + w - 1, y, 1, h, on);
+}
+
+/* display_bitmap:
+   Copy a w columns by pages pages bitmap, stored page by page like
+   display RAM, into the frame at column x and page. Set invert to
+   draw the complement, as display_image does. */
+void display_bitmap(int x, int w, int page, int pages, const uint8_t *data, int invert)
+{
+  int i, j;
+  uint8_t mask = invert ? 0xFF : 0;
+
+  if (x < 0 || x >= 128 || page < 0 || w <= 0)
+    return;
+  for (i = 0; i < pages && page + i < 4; i++)
+  {
+    for (j = 0; j < w && x + j < 128; j++)
+      framebuffer[page + i][x + j] = data[i * w + j] ^ mask;
+    fb_touch(page + i, x, x + j - 1);
+  }
+}
+
+/* display_blit:
+   Draw a w by h bitmap with its top left corner at any pixel (x, y),
+   which may be partly off screen. data is stored like display RAM:
+   ceil(h / 8) pages of w bytes, bit 0 the top row of each page. Each
+   source column is gathered into one 32-bit word, shifted to row y
+   and merged into every page it covers with a mask, so no pixel is
+   handled on its own. With opaque set, the rows covered are replaced;
+   otherwise only set pixels are drawn. */
+void display_blit(int x, int y, int w, int h, const uint8_t *data, int opaque)
+{
+  int pages = (h + 7) >> 3;
+  int j, p, p0, p1;
+  uint32_t col, mask, m;
+
+  if (h <= 0 || h > 32 || y <= -h || y >= 32 || x <= -w || x >= 128)
+    return;
+  mask = h == 32 ? 0xFFFFFFFF : (1u << h) - 1;
+  mask = y >= 0 ? mask << y : mask >> -y;
+  p0 = y > 0 ? y >> 3 : 0;
+  p1 = y + h - 1 < 31 ? (y + h - 1) >> 3 : 3;
 
+  for (j = x < 0 ? -x : 0; j < w && x + j < 128; j++)
+  {
+    col = 0;
+    for (p = 0; p < pages; p++)
+      col |= (uint32_t)data[p * w + j] << (p * 8);
+    col = y >= 0 ? col << y : col >> -y;
+    col &= mask;
+    for (p = p0; p <= p1; p++)
+    {
+      m = mask >> (p * 8) & 0xFF;
+      if (opaque)
+        framebuffer[p][x + j] = (framebuffer[p][x + j] & ~m) | (col >> (p * 8) & 0xFF);
+      else
+        framebuffer[p][x + j] |= col >> (p * 8);
+    }
+  }
+  j = x < 0 ? 0 : x;
+  for (p = p0; p <= p1; p++)
+    fb_touch(p, j, x + w - 1 < 127 ? x + w - 1 : 127);
+}
+
+/* display_text:
+   Draw s in the font at any pixel (x, y), through display_blit. Unlike
+   the text lines this is drawn straight into the frame, so it does
+   not need to line up with pages or 8-column cells. Returns the x
+   just past the last character, for drawing what follows. */
+int display_text(int x, int y, const char *s, int opaque)
+{
+  uint8_t g[8];
+
+  for (; *s && x < 128; s++, x += 8)
+  {
+    font_glyph(*s, g);
+    display_blit(x, y, 8, 8, g, opaque);
+  }
+  return x;
+}
+
+/* display_window:
+   Draw a w columns by pages pages rectangle of display RAM bytes and
+   send it. With w = 128 and pages = 4 this is a whole 512-byte frame,
+   which goes out as one data burst. */
+void display_window(int x, int w, int page, int pages, const uint8_t *data)
+{
+  display_bitmap(x, w, page, pages, data, 0);
+  display_update();
+}
+
+/* display_image:
+   Draw a 32x32 image at column x and send it straight away. */
+void display_image(int x, const uint8_t *data)
+{
+  display_bitmap(x, 32, 0, 4, data, 1);
+  display_update();
+}
+
+/* font_glyph:
+   Write the 8 columns of character c to dst. */
+void font_glyph(int c, uint8_t *dst)
+{
+  const uint8_t *g = font_glyphs[font_map[c & 0xFF]];
+  int i;
+
+  for (i = 0; i < 8; i++)
+    dst[i] = g[i];
+}
+
+/* display_render_text:
+   Rasterize the cells of textbuffer that changed since they were
+   last rendered. Text is drawn into the frame like any other bitmap,
+   so whatever is drawn last over a cell is what shows. display_update
+   calls this first; call it directly to get text changes into the
+   frame before drawing graphics over them. */
+void display_render_text(void)
+{
+  int i, j;
+  int c;
+
+  for (i = 0; i < 4; i++)
+  {
     for (j = 0; j < 16; j++)
     {
       c = textbuffer[i][j];
-      if (c & 0x80)
+      if (c == textshadow[i][j] && !(textforce[i] & (1 << j)))
         continue;
+      textshadow[i][j] = c;
+      font_glyph(c, &framebuffer[i][j * 8]);
+      fb_touch(i, j * 8, j * 8 + 7);
+    }
+    textforce[i] = 0;
+  }
+}
+
+/* display_unpack:
+   Unpack a bitmap packed by tools/mkassets straight into the frame,
+   as a w columns by pages pages window at column x and page. A
+   control byte c below 128 is followed by c + 1 bytes to copy; from
+   128 up it is followed by one byte to repeat c - 126 times. */
+void display_unpack(int x, int w, int page, int pages, const uint8_t *src)
+{
+  uint8_t *d = &framebuffer[page][x];
+  int left = w * pages, col = 0, n, c;
 
-      for (k = 0; k < 8; k++)
-        spi_send_recv(font[c * 8 + k]);
+  if (x < 0 || x + w > 128 || page < 0 || page + pages > 4)
+    return;
+  while (left > 0)
+  {
+    c = *src++;
+    n = c < 128 ? c + 1 : c - 126;
+    for (; n > 0 && left > 0; n--, left--)
+    {
+      *d++ = *src;
+      if (c < 128)
+        src++;
+      if (++col == w)
+      {
+        col = 0;
+        d += 128 - w;
+      }
     }
+    if (c >= 128)
+      src++;
+  }
+  for (c = page; c < page + pages; c++)
+    fb_touch(c, x, x + w - 1);
+}
+
+/* display_screen:
+   Unpack a pre-rendered screen image into the frame and set the text
+   lines to the lines it shows. The lines
+   are recorded as already rendered, so display_string calls that
+   follow only redraw the cells they change. */
+void display_screen(const uint8_t *image, const char *const lines[4])
+{
+  int i, j;
+
+  display_unpack(0, 128, 0, 4, image);
+  for (i = 0; i < 4; i++)
+  {
+    display_string(i, (char *)lines[i]);
+    for (j = 0; j < 4; j++)
+      ((uint32_t *)textshadow[i])[j] = ((uint32_t *)textbuffer[i])[j];
+    textforce[i] = 0;
   }
 }
 
+/* display_text_invalidate:
+   Rasterize every text cell again on the next display_update,
+   drawing the text back over whatever graphics covered it. */
+void display_text_invalidate(void)
+{
+  int i;
+  for (i = 0; i < 4; i++)
+    textforce[i] = 0xFFFF;
+}
+
+/* display_scroll_column:
+   Scroll pages page to page + pages - 1 one column to the left and
+   push one new column, given top page first, at the right edge.
+   The panel scrolls itself with the SSD1306 one-column content
+   scroll (0x2D), so this costs 8 command bytes, a window and one
+   byte per page instead of resending the pages. Both frames are
+   shifted the same way in RAM so later updates agree with the panel.
+   The controller needs a frame time (about 10 ms) between two
+   content scrolls. */
+void display_scroll_column(int page, int pages, const uint8_t *column)
+{
+  uint8_t(*f)[128];
+  int n, i, j;
+
+  display_flush_wait();
+  for (n = 0; n < 2; n++)
+  {
+    f = frames[n];
+    for (i = page; i < page + pages; i++)
+    {
+      for (j = 0; j < 127; j++)
+        f[i][j] = f[i][j + 1];
+      f[i][127] = column[i - page];
+    }
+  }
+  /* Changes waiting in the back frame moved left with everything else */
+  for (i = page; i < page + pages; i++)
+    if (fb_hi[i] >= fb_lo[i])
+    {
+      if (fb_lo[i] > 0)
+        fb_lo[i]--;
+      fb_hi[i]--;
+    }
+
+  spi_queue_reset();
+  spi_queue_cmd(0x2D);
+  spi_queue_cmd(0x00);
+  spi_queue_cmd(page);
+  spi_queue_cmd(0x01);
+  spi_queue_cmd(page + pages - 1);
+  spi_queue_cmd(0x00);
+  spi_queue_cmd(0x00);
+  spi_queue_cmd(0x7F);
+  spi_queue_window(127, 1, page, pages);
+  for (i = page; i < page + pages; i++)
+    spi_queue(&display_front[i][127], 1, SPI_SEG_DATA);
+  spi_run_queue();
+}
+
+/* Swap the frames: what was drawn becomes the front frame to send,
+   and drawing continues in the other one. The new back frame is two
+   frames old and differs from the front only in the columns just
+   handed over, so those are copied across. Interrupts are off for
+   the swap, so an interrupt handler drawing into framebuffer sees
+   either the old back frame or the up-to-date new one. Only called
+   while no flush is reading the front frame. */
+static void display_swap(void)
+{
+  uint8_t(*f)[128];
+  int i, j;
+  unsigned int status;
+
+  status = disable_interrupt();
+  f = display_front;
+  display_front = framebuffer;
+  framebuffer = f;
+  for (i = 0; i < 4; i++)
+  {
+    send_lo[i] = fb_lo[i];
+    send_hi[i] = fb_hi[i];
+    fb_lo[i] = 127;
+    fb_hi[i] = -1;
+    for (j = send_lo[i]; j <= send_hi[i]; j++)
+      framebuffer[i][j] = display_front[i][j];
+  }
+  restore_interrupt(status);
+}
+
+/* Queue the changed columns of the front frame. Each dirty page costs
+   a window preamble plus its changed columns; when several pages
+   changed over similar columns one window spanning all of them is
+   cheaper, and the cheaper of the two is queued. Either way every
+   page's bytes are contiguous in the frame, so a window is a single
+   data burst. */
+static void display_queue_frame(void)
+{
+  int i, x0 = 127, x1 = 0, p0 = 4, p1 = -1;
+  unsigned int sent = 0, boxcost, pages = 0;
+
+  for (i = 0; i < 4; i++)
+  {
+    if (send_hi[i] < send_lo[i])
+      continue;
+    pages++;
+    sent += DISPLAY_WINDOW_BYTES + send_hi[i] - send_lo[i] + 1;
+    if (send_lo[i] < x0)
+      x0 = send_lo[i];
+    if (send_hi[i] > x1)
+      x1 = send_hi[i];
+    if (i < p0)
+      p0 = i;
+    p1 = i;
+  }
+
+  spi_queue_reset();
+  boxcost = DISPLAY_WINDOW_BYTES + (x1 - x0 + 1) * (p1 - p0 + 1);
+  if (pages > 1 && boxcost <= sent)
+  {
+    sent = boxcost;
+    spi_queue_window(x0, x1 - x0 + 1, p0, p1 - p0 + 1);
+    for (i = p0; i <= p1; i++)
+      spi_queue(&display_front[i][x0], x1 - x0 + 1, SPI_SEG_DATA);
+  }
+  else
+  {
+    for (i = 0; i < 4; i++)
+    {
+      if (send_hi[i] < send_lo[i])
+        continue;
+      spi_queue_window(send_lo[i], send_hi[i] - send_lo[i] + 1, i, 1);
+      spi_queue(&display_front[i][send_lo[i]], send_hi[i] - send_lo[i] + 1, SPI_SEG_DATA);
+    }
+  }
+
+  display_bytes_saved = DISPLAY_FULL_FRAME_BYTES - sent;
+  display_bytes_saved_total += display_bytes_saved;
+}
+
+/* display_update:
+   Render the changed text, swap frames, then send everything that
+   changed and return when it is on the panel. */
+void display_update(void)
+{
+  display_render_text();
+  display_flush_wait();
+  display_swap();
+  display_queue_frame();
+  spi_run_queue();
+}
+
+/* display_update_async:
+   Like display_update, but the bytes are sent from the SPI2 TX
+   interrupt and the function returns at once. Drawing may go on in
+   framebuffer during the flush. Returns 0 without swapping if the
+   previous flush is still running; what was drawn stays in the back
+   frame and goes out with the next call. Poll display_flush_done to
+   find out when the panel is up to date. Requires interrupts to be
+   enabled. */
+int display_update_async(void)
+{
+  display_render_text();
+  if (!display_flush_done())
+    return 0;
+  display_swap();
+  display_queue_frame();
+  spi_start_queue();
+  return 1;
+}
+
 /* Helper function, local to this file.
    Converts a number to hexadecimal ASCII digits. */
 static void num32asc(char *s, int n)
@@ -0,0 +1,137 @@
+/* mipslabgfx.c
+   Graphics drawn into the display framebuffer.
+
+   For copyright and licensing, see file COPYING */
+
+#include <stdint.h>  /* Declarations of uint_32 and the like */
+#include <pic32mx.h> /* Declarations of system-specific addresses etc */
+#include "mipslab.h" /* Declatations for these labs */
+
+/* Characters the large readout can show, in cache slot order */
+static const char bignum_chars[] = "0123456789.- CKF\xB0";
+#define BIGNUM_GLYPHS (sizeof(bignum_chars) - 1)
+
+/* Scaled copies of those glyphs from the font, built on first use.
+   A glyph scaled by s is 8s columns by s pages, stored page by page
+   the way display_bitmap takes it. */
+static uint8_t bignum2[BIGNUM_GLYPHS][16 * 2];
+static uint8_t bignum3[BIGNUM_GLYPHS][24 * 3];
+static uint32_t bignum2_ready, bignum3_ready;
+
+/* Pages the readout covers, so bignum_end knows what to clear */
+static int bignum_page, bignum_pages;
+
+static int bignum_slot(char c)
+{
+  int i;
+  for (i = 0; i < BIGNUM_GLYPHS; i++)
+    if (bignum_chars[i] == c)
+      return i;
+  return 12; /* ' ' */
+}
+
+/* Scale the 8x8 glyph for c by s into out. Every source row becomes
+   s rows and every source column s columns. */
+static void bignum_build(char c, int s, uint8_t *out)
+{
+  uint8_t g[8];
+  uint32_t bits;
+  int col, row, k, p;
+
+  font_glyph(c, g);
+  for (col = 0; col < 8; col++)
+  {
+    bits = 0;
+    for (row = 0; row < 8; row++)
+      if (g[col] & (1 << row))
+        bits |= ((1 << s) - 1) << (row * s);
+    for (k = 0; k < s; k++)
+      for (p = 0; p < s; p++)
+        out[p * 8 * s + col * s + k] = bits >> (p * 8);
+  }
+}
+
+/* Cached glyph for c at scale s, building it the first time */
+static const uint8_t *bignum_glyph(char c, int s)
+{
+  int slot = bignum_slot(c);
+  uint32_t *ready = s == 3 ? &bignum3_ready : &bignum2_ready;
+  uint8_t *g = s == 3 ? bignum3[slot] : bignum2[slot];
+
+  if (!(*ready & (1 << slot)))
+  {
+    bignum_build(bignum_chars[slot], s, g);
+    *ready |= 1 << slot;
+  }
+  return g;
+}
+
+/* bignum_show:
+   Draw s in characters scaled 2 or 3 times, from the left edge of
+   page. Each character is a straight copy of its cached glyph into
+   the frame; the rest of the covered pages is cleared. The text
+   lines under the readout are blanked, so they do not get drawn
+   over it. Only digits, '.', '-', ' ', 'C', 'K', 'F' and the degree
+   sign are available; anything else shows as a space. */
+void bignum_show(int page, const char *s, int scale)
+{
+  int x = 0, w, i;
+
+  if (scale != 3)
+    scale = 2;
+  w = 8 * scale;
+  if (page + scale > 4)
+    page = 4 - scale;
+
+  for (i = page; i < page + scale; i++)
+    display_string(i, "");
+  display_render_text();
+
+  for (; *s && x + w <= 128; s++, x += w)
+    display_bitmap(x, w, page, scale, bignum_glyph(*s, scale), 0);
+  display_fill_rect(x, page * 8, 128 - x, scale * 8, 0);
+
+  bignum_page = page;
+  bignum_pages = scale;
+}
+
+/* bignum_end:
+   Remove the readout and give its pages back to the text lines. */
+void bignum_end(void)
+{
+  if (bignum_pages == 0)
+    return;
+  display_fill_rect(0, bignum_page * 8, 128, bignum_pages * 8, 0);
+  display_text_invalidate();
+  bignum_pages = 0;
+}
+
+/* Text lines of each pre-rendered screen */
+static const char *const screen_lines[][4] = {
+#define SCREEN(id, l0, l1, l2, l3) {l0, l1, l2, l3},
+#include "assets/screens.def"
+#undef SCREEN
+};
+
+/* screen_show:
+   Show a menu screen from its pre-rendered image, with nothing
+   rasterized on the way. */
+void screen_show(int id)
+{
+  display_screen(screen_images[id], screen_lines[id]);
+  display_update();
+}
+
+/* screen_select:
+   Show screen id, already on the display, with text on one line in
+   place of what the screen has there, e.g. a "selected" marker. The
+   other lines go back to the screen's own text. Only the cells that
+   differ from what is shown are redrawn and sent. */
+void screen_select(int id, int line, char *text)
+{
+  int i;
+
+  for (i = 0; i < 4; i++)
+    display_string(i, i == line ? text : (char *)screen_lines[id][i]);
+  display_update();
+}
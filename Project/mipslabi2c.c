@@ -0,0 +1,1074 @@
+/* mipslabi2c.c
+   I2C1 master driven by its interrupt, and the temperature sensor
+   reads built on it. Transfers are queued as batches of descriptors;
+   the interrupt handler runs each batch back to back, one bus event
+   per interrupt, so the CPU is free while the bytes are on the wire.
+
+   For copyright and licensing, see file COPYING */
+
+#include <stdint.h>  /* Declarations of uint_32 and the like */
+#include <pic32mx.h> /* Declarations of system-specific addresses etc */
+#include "mipslab.h" /* Declatations for these labs */
+
+/* I2C1CON bits */
+#define I2CCON_SEN 0x01   /* Start condition */
+#define I2CCON_RSEN 0x02  /* Repeated start */
+#define I2CCON_PEN 0x04   /* Stop condition */
+#define I2CCON_RCEN 0x08  /* Receive a byte */
+#define I2CCON_ACKEN 0x10 /* Send ACKDT */
+#define I2CCON_ACKDT 0x20 /* 1 to not acknowledge */
+#define I2CCON_DISSLW 0x200 /* Slew rate control off */
+#define I2CCON_SIDL 0x2000
+#define I2CCON_ON 0x8000
+
+/* I2C1STAT bits */
+#define I2CSTAT_BCL 0x400      /* Bus collision */
+#define I2CSTAT_ACKSTAT 0x8000 /* The slave did not acknowledge */
+
+/* Interrupt bits for the I2C1 master: IRQ 31 in IFS0/IEC0,
+   vector 25 with its priority in IPC6<12:10> */
+#define I2C1M_IRQ_MASK (1u << 31)
+#define I2C1_IPC_SHIFT 10
+#define I2C1_PRIORITY 2
+
+/* Baud rate divider for I2C1_HZ, from the reference manual:
+   BRG = (1 / (2 * F) - TPGD) * PBCLK - 2, with the 104 ns pulse
+   gobbler delay TPGD. Slew rate control is only for 400 kHz. */
+#define I2C1_TPGD_NS 104
+#define I2C1_BRG (PBCLK_HZ / (2 * I2C1_HZ) - PBCLK_HZ / 1000000 * I2C1_TPGD_NS / 1000 - 2)
+#if I2C1_HZ != 100000 && I2C1_HZ != 400000 && I2C1_HZ != 1000000
+#error "I2C1_HZ must be 100000, 400000 or 1000000"
+#endif
+#if I2C1_BRG < 2 || I2C1_BRG > 0xFFF
+#error "I2C1_BRG out of range for PBCLK_HZ"
+#endif
+
+/* Longest a bus event may take before the batch is given up. A byte
+   takes 90 us at 100 kHz, so only a stuck bus gets near it. */
+#define I2C_TIMEOUT_US 1000
+
+/* I2C1 pins, for clocking a stuck slave free by hand */
+#define I2C1_SCL (1 << 2) /* RG2 */
+#define I2C1_SDA (1 << 3) /* RG3 */
+#define I2C_RECOVER_CLOCKS 9
+#define I2C_RECOVER_HALF_US 5 /* Half an SCL period, 100 kHz */
+
+/* What the master waits for to finish. Each interrupt means the
+   step named here is done and the next one can be started. */
+#define I2C_STEP_IDLE 0
+#define I2C_STEP_START 1   /* Start or repeated start of a descriptor */
+#define I2C_STEP_ADDR_W 2  /* Address with the write bit */
+#define I2C_STEP_WRITE 3   /* A data byte out */
+#define I2C_STEP_RESTART 4 /* Repeated start before the read */
+#define I2C_STEP_ADDR_R 5  /* Address with the read bit */
+#define I2C_STEP_RECV 6    /* A data byte in */
+#define I2C_STEP_ACK 7     /* Acknowledge of the byte in */
+#define I2C_STEP_STOP 8    /* Stop condition at the end of a batch */
+#define I2C_STEP_RECOVER 9 /* Aborted, the bus to be freed by i2c_service */
+
+/* Batches waiting to run, the first one running */
+#define I2C_BATCH_MAX 4
+
+struct i2c_batch
+{
+  struct i2c_desc *d;
+  int n;
+  void (*done)(struct i2c_desc *d, int n);
+};
+
+static struct i2c_batch i2c_queue[I2C_BATCH_MAX];
+static int i2c_head;
+static volatile int i2c_count;
+
+/* Where the running batch is */
+static volatile int i2c_step;
+static int i2c_pos;
+static const uint8_t *i2c_wp;
+static int i2c_wlen;
+static uint8_t *i2c_rp;
+static int i2c_rlen;
+
+/* Core timer at the last bus event of the running batch */
+static unsigned int i2c_event_time;
+
+/* i2c_init:
+   Set up I2C1 as master and its interrupt. */
+void i2c_init(void)
+{
+  I2C1CON = 0x0;
+  I2C1BRG = I2C1_BRG;
+  I2C1STAT = 0x0;
+  I2C1CONSET = I2CCON_SIDL;
+  if (I2C1_HZ != 400000)
+    I2C1CONSET = I2CCON_DISSLW;
+  I2C1CONSET = I2CCON_ON;
+  (void)I2C1RCV; /* Clear receive buffer */
+
+  IPCCLR(6) = 0x1F << 8;
+  IPCSET(6) = I2C1_PRIORITY << I2C1_IPC_SHIFT;
+  IFSCLR(0) = I2C1M_IRQ_MASK;
+  IECSET(0) = I2C1M_IRQ_MASK;
+}
+
+/* Start the batch at the head of the queue */
+static void i2c_start_batch(void)
+{
+  i2c_pos = 0;
+  i2c_step = I2C_STEP_START;
+  i2c_event_time = core_timer();
+  I2C1CONSET = I2CCON_SEN;
+}
+
+/* Finish the current descriptor with status, then go on to the next
+   one with a repeated start, or end the batch with a stop */
+static void i2c_next(int status)
+{
+  struct i2c_batch *b = &i2c_queue[i2c_head];
+
+  b->d[i2c_pos++].status = status;
+  if (i2c_pos < b->n)
+  {
+    i2c_step = I2C_STEP_START;
+    I2C1CONSET = I2CCON_RSEN;
+  }
+  else
+  {
+    i2c_step = I2C_STEP_STOP;
+    I2C1CONSET = I2CCON_PEN;
+  }
+}
+
+/* Take the finished batch off the queue, tell its owner, and start
+   the next one. The callback may submit a new batch. */
+static void i2c_end_batch(void)
+{
+  struct i2c_batch b = i2c_queue[i2c_head];
+
+  i2c_head = (i2c_head + 1) % I2C_BATCH_MAX;
+  i2c_count--;
+  i2c_step = I2C_STEP_IDLE;
+  if (b.done)
+    b.done(b.d, b.n);
+  if (i2c_step == I2C_STEP_IDLE && i2c_count > 0)
+    i2c_start_batch();
+}
+
+/* i2c_recover:
+   Free a bus that a slave holds SDA low on, because it lost count
+   of the clocks in a transfer cut short: with I2C1 off, clock SCL
+   by hand until SDA is let go, up to a byte and the acknowledge,
+   then send a stop. Returns 1 if both lines are high after it. */
+int i2c_recover(void)
+{
+  int i, ok;
+
+  I2C1CONCLR = I2CCON_ON;
+  ODCGSET = I2C1_SCL | I2C1_SDA;
+  PORTGSET = I2C1_SCL | I2C1_SDA;
+  TRISGCLR = I2C1_SCL | I2C1_SDA;
+  delay_us(I2C_RECOVER_HALF_US);
+
+  for (i = 0; i < I2C_RECOVER_CLOCKS && !(PORTG & I2C1_SDA); i++)
+  {
+    PORTGCLR = I2C1_SCL;
+    delay_us(I2C_RECOVER_HALF_US);
+    PORTGSET = I2C1_SCL;
+    delay_us(I2C_RECOVER_HALF_US);
+  }
+
+  /* Stop: SDA goes high while SCL is high */
+  PORTGCLR = I2C1_SCL;
+  delay_us(I2C_RECOVER_HALF_US);
+  PORTGCLR = I2C1_SDA;
+  delay_us(I2C_RECOVER_HALF_US);
+  PORTGSET = I2C1_SCL;
+  delay_us(I2C_RECOVER_HALF_US);
+  PORTGSET = I2C1_SDA;
+  delay_us(I2C_RECOVER_HALF_US);
+
+  ok = (PORTG & (I2C1_SCL | I2C1_SDA)) == (I2C1_SCL | I2C1_SDA);
+  TRISGSET = I2C1_SCL | I2C1_SDA;
+  ODCGCLR = I2C1_SCL | I2C1_SDA;
+  I2C1STATCLR = I2CSTAT_BCL;
+  I2C1CONSET = I2CCON_ON;
+  return ok;
+}
+
+/* Give up the running batch: the descriptors not done get status.
+   With no other master, a timeout or a collision both mean a slave
+   holds a line, so the batch stays on the queue until i2c_service
+   has clocked the bus free, which is too slow for the interrupt
+   handler. Nothing else starts on the bus meanwhile. */
+static void i2c_abort(int status)
+{
+  struct i2c_desc *d = &i2c_queue[i2c_head].d[i2c_pos];
+
+  for (; i2c_pos < i2c_queue[i2c_head].n; i2c_pos++, d++)
+    d->status = status;
+  i2c_step = I2C_STEP_RECOVER;
+}
+
+/* i2c_submit:
+   Queue a batch of n transfers to run back to back, each one in d.
+   A descriptor writes wlen bytes from w to the 7-bit address addr
+   and then, after a repeated start, reads rlen bytes into r; either
+   length may be 0. Its status is I2C_BUSY until it has run, then
+   I2C_OK, I2C_NACK if the slave did not acknowledge,
+   I2C_COLLISION if the bus was lost, or I2C_TIMEOUT if a step did
+   not finish within I2C_TIMEOUT_US. When the whole batch is done,
+   done is called with it from the interrupt handler, unless it is
+   0. The descriptors and buffers must stay valid until then.
+   Returns 0 without queueing if the queue is full. */
+int i2c_submit(struct i2c_desc *d, int n, void (*done)(struct i2c_desc *d, int n))
+{
+  struct i2c_batch *b;
+  unsigned int status;
+  int i;
+
+  status = disable_interrupt();
+  if (i2c_count == I2C_BATCH_MAX)
+  {
+    restore_interrupt(status);
+    return 0;
+  }
+  for (i = 0; i < n; i++)
+    d[i].status = I2C_BUSY;
+  b = &i2c_queue[(i2c_head + i2c_count) % I2C_BATCH_MAX];
+  b->d = d;
+  b->n = n;
+  b->done = done;
+  i2c_count++;
+  if (i2c_step == I2C_STEP_IDLE)
+    i2c_start_batch();
+  restore_interrupt(status);
+  return 1;
+}
+
+/* i2c_service:
+   Handle a waiting bus event. The interrupt handler does this when
+   interrupts are on; before that, polling through here moves the
+   queue on. It is also where a batch whose bus event never came is
+   timed out, and where the bus is freed after an aborted batch, so
+   whatever waits on a transfer has to call it. */
+void i2c_service(void)
+{
+  unsigned int status;
+
+  if (i2c_step == I2C_STEP_IDLE)
+    return;
+  if (i2c_step == I2C_STEP_RECOVER)
+  {
+    /* With interrupts on: only this clears the step, and the
+       interrupt handler leaves the bus alone until then */
+    i2c_recover();
+    status = disable_interrupt();
+    IFSCLR(0) = I2C1M_IRQ_MASK; /* Not an event of the next batch */
+    i2c_end_batch();
+    restore_interrupt(status);
+    return;
+  }
+  status = disable_interrupt();
+  if (IFS(0) & I2C1M_IRQ_MASK)
+    i2c_isr();
+  else if (i2c_step != I2C_STEP_IDLE &&
+           core_timer() - i2c_event_time > I2C_TIMEOUT_US * (CORE_TIMER_HZ / 1000000))
+    i2c_abort(I2C_TIMEOUT);
+  restore_interrupt(status);
+}
+
+/* i2c_isr:
+   I2C1 master interrupt handler, called from user_isr. Starts the
+   next step of the running batch now that the last one is done. */
+void i2c_isr(void)
+{
+  struct i2c_desc *d;
+
+  IFSCLR(0) = I2C1M_IRQ_MASK;
+  if (i2c_step == I2C_STEP_IDLE || i2c_step == I2C_STEP_RECOVER)
+    return;
+  d = &i2c_queue[i2c_head].d[i2c_pos];
+  i2c_event_time = core_timer();
+
+  if (I2C1STAT & I2CSTAT_BCL)
+  {
+    /* The hardware has let go of the bus. The rest of the batch
+       fails with it. */
+    I2C1STATCLR = I2CSTAT_BCL;
+    i2c_abort(I2C_COLLISION);
+    return;
+  }
+
+  switch (i2c_step)
+  {
+  case I2C_STEP_START:
+    i2c_wp = d->w;
+    i2c_wlen = d->wlen;
+    i2c_rp = d->r;
+    i2c_rlen = d->rlen;
+    if (i2c_wlen > 0 || i2c_rlen == 0)
+    {
+      i2c_step = I2C_STEP_ADDR_W;
+      I2C1TRN = d->addr << 1;
+    }
+    else
+    {
+      i2c_step = I2C_STEP_ADDR_R;
+      I2C1TRN = (d->addr << 1) | 1;
+    }
+    break;
+
+  case I2C_STEP_ADDR_W:
+  case I2C_STEP_WRITE:
+    if (I2C1STAT & I2CSTAT_ACKSTAT)
+      i2c_next(I2C_NACK);
+    else if (i2c_wlen > 0)
+    {
+      i2c_step = I2C_STEP_WRITE;
+      i2c_wlen--;
+      I2C1TRN = *i2c_wp++;
+    }
+    else if (i2c_rlen > 0)
+    {
+      i2c_step = I2C_STEP_RESTART;
+      I2C1CONSET = I2CCON_RSEN;
+    }
+    else
+      i2c_next(I2C_OK);
+    break;
+
+  case I2C_STEP_RESTART:
+    i2c_step = I2C_STEP_ADDR_R;
+    I2C1TRN = (d->addr << 1) | 1;
+    break;
+
+  case I2C_STEP_ADDR_R:
+    if (I2C1STAT & I2CSTAT_ACKSTAT)
+    {
+      i2c_next(I2C_NACK);
+      break;
+    }
+    i2c_step = I2C_STEP_RECV;
+    I2C1CONSET = I2CCON_RCEN;
+    break;
+
+  case I2C_STEP_RECV:
+    /* Acknowledge every byte but the last, which ends the read */
+    *i2c_rp++ = I2C1RCV;
+    i2c_rlen--;
+    if (i2c_rlen > 0)
+      I2C1CONCLR = I2CCON_ACKDT;
+    else
+      I2C1CONSET = I2CCON_ACKDT;
+    i2c_step = I2C_STEP_ACK;
+    I2C1CONSET = I2CCON_ACKEN;
+    break;
+
+  case I2C_STEP_ACK:
+    if (i2c_rlen > 0)
+    {
+      i2c_step = I2C_STEP_RECV;
+      I2C1CONSET = I2CCON_RCEN;
+    }
+    else
+      i2c_next(I2C_OK);
+    break;
+
+  case I2C_STEP_STOP:
+    i2c_end_batch();
+    break;
+  }
+}
+
+/* TCN75A configuration register: the resolution in bits 6:5, one-shot
+   and shutdown. The rest sets up the alert output. */
+#define TEMP_CONF_SHUTDOWN 0x01
+#define TEMP_CONF_INT_MODE 0x02 /* Alert in interrupt mode, not comparator */
+#define TEMP_CONF_RES_SHIFT 5
+#define TEMP_CONF_ONESHOT 0x80
+
+/* Conversion time in ms for 9 to 12 bits, the maximum values from
+   the TCN75A datasheet. A typical part is done in 40% of this, but
+   there is no ready flag, and a read before the conversion ends gets
+   the one before it; so samples wait for the slowest part, at the
+   cost of a lower sample rate. */
+static const uint16_t temp_conv_ms[4] = {75, 150, 300, 600};
+
+/* Buffers for the sensor transfers: the configuration write with a
+   read-back of the register, the one-shot trigger, and the
+   temperature read */
+static uint8_t temp_conf[2] = {TEMP_SENSOR_REG_CONF, 0x0};
+static const uint8_t temp_conf_reg = TEMP_SENSOR_REG_CONF;
+static uint8_t temp_conf_back;
+static uint8_t temp_trigger[2] = {TEMP_SENSOR_REG_CONF, 0x0};
+static const uint8_t temp_reg = TEMP_SENSOR_REG_TEMP;
+static uint8_t temp_buf[2];
+
+static struct i2c_desc temp_conf_desc[2] = {
+    {TEMP_SENSOR_ADDR, 2, 0, I2C_OK, temp_conf, 0},
+    {TEMP_SENSOR_ADDR, 1, 1, I2C_OK, &temp_conf_reg, &temp_conf_back},
+};
+static struct i2c_desc temp_trigger_desc = {TEMP_SENSOR_ADDR, 2, 0, I2C_OK, temp_trigger, 0};
+static struct i2c_desc temp_read_desc = {TEMP_SENSOR_ADDR, 1, 2, I2C_OK, &temp_reg, temp_buf};
+
+/* 0 while a read runs, 1 when temp_value holds its result, minus
+   its I2C status when it failed. The configuration only uses -1. */
+static volatile int temp_state = 1;
+static int16_t temp_value;
+/* How the last read that finished went, 0 before the first */
+static volatile int temp_last_state;
+static volatile int temp_conf_state = 1;
+
+/* The register each sensor's pointer is at, which it keeps between
+   transfers, or TEMP_POINTER_UNKNOWN after a failed one. A read of
+   the temperature register only has to write the pointer when it is
+   somewhere else. Sensors are indexed by address from
+   TEMP_SENSOR_ADDR, so the main one is 0. */
+#define TEMP_POINTER_UNKNOWN -1
+static volatile int8_t temp_pointer[TEMP_CHANNEL_MAX] = {
+    TEMP_POINTER_UNKNOWN, TEMP_POINTER_UNKNOWN, TEMP_POINTER_UNKNOWN, TEMP_POINTER_UNKNOWN,
+    TEMP_POINTER_UNKNOWN, TEMP_POINTER_UNKNOWN, TEMP_POINTER_UNKNOWN, TEMP_POINTER_UNKNOWN,
+};
+
+/* 1 when the configuration register is known to hold temp_conf[1] */
+static int temp_conf_known;
+
+/* 1 to read only the whole degrees, see temp_whole */
+static int temp_whole_only;
+
+/* Alert mode bits temp_mode adds to the configuration, and 1 while
+   the T_HYST and T_SET writes, which move the pointer, are queued */
+static uint8_t temp_alert_conf;
+static volatile int temp_alert_busy;
+
+/* The mode set by temp_mode */
+static int temp_bits = 9;
+static int temp_oneshot;
+
+/* Where temp_sample_poll is, and the core timer value from which a
+   conversion the last reading has not seen is ready */
+#define TEMP_IDLE 0
+#define TEMP_WAIT 1 /* For the conversion */
+#define TEMP_READ 2 /* For the read */
+static int temp_phase;
+static unsigned int temp_fresh;
+
+/* Transfers of a sample tried again before it fails, and how many
+   the running one has used */
+#define TEMP_RETRIES 2
+static int temp_retries = TEMP_RETRIES;
+static int temp_tries;
+
+static void temp_done(struct i2c_desc *d, int n)
+{
+  if (d->status == I2C_OK)
+  {
+    temp_value = temp_buf[0] << 8;
+    if (d->rlen > 1)
+      temp_value |= temp_buf[1];
+    temp_pointer[0] = TEMP_SENSOR_REG_TEMP;
+    temp_state = 1;
+  }
+  else
+  {
+    temp_pointer[0] = TEMP_POINTER_UNKNOWN;
+    temp_state = -d->status;
+  }
+  temp_last_state = temp_state;
+}
+
+/* The configuration took if the register reads back as written; the
+   one-shot bit always reads as 0 */
+static void temp_conf_done(struct i2c_desc *d, int n)
+{
+  if (d[0].status == I2C_OK && d[1].status == I2C_OK &&
+      temp_conf_back == (temp_conf[1] & ~TEMP_CONF_ONESHOT))
+  {
+    temp_pointer[0] = TEMP_SENSOR_REG_CONF;
+    temp_conf_known = 1;
+    temp_conf_state = 1;
+  }
+  else
+  {
+    temp_pointer[0] = TEMP_POINTER_UNKNOWN;
+    temp_conf_known = 0;
+    temp_conf_state = -1;
+  }
+}
+
+/* The one-shot trigger leaves the pointer at the configuration */
+static void temp_trigger_done(struct i2c_desc *d, int n)
+{
+  temp_pointer[0] = d->status == I2C_OK ? TEMP_SENSOR_REG_CONF : TEMP_POINTER_UNKNOWN;
+}
+
+static unsigned int temp_conv_ticks(void)
+{
+  return temp_conv_ms[temp_bits - 9] * (CORE_TIMER_HZ / 1000);
+}
+
+/* Bytes of pointer a read of the temperature register from sensor i
+   has to write first. It can be left out when the pointer is there
+   already and no configuration write that moves it is queued. */
+static int temp_pointer_len(int i)
+{
+  if (temp_conf_state == 0 || temp_trigger_desc.status == I2C_BUSY || temp_alert_busy)
+    return 1;
+  return temp_pointer[i] == TEMP_SENSOR_REG_TEMP ? 0 : 1;
+}
+
+/* temp_read_begin:
+   Start reading the temperature register now. The pointer is only
+   written when the sensor's is elsewhere or not known, which needs
+   no other sensor transfer to be queued. Returns 0 if a read is
+   already under way or the I2C queue is full. */
+int temp_read_begin(void)
+{
+  if (temp_state == 0)
+    return 0;
+  temp_read_desc.wlen = temp_pointer_len(0);
+  temp_read_desc.rlen = temp_whole_only ? 1 : 2;
+  temp_state = 0;
+  if (!i2c_submit(&temp_read_desc, 1, temp_done))
+  {
+    temp_state = -I2C_BUSY;
+    return 0;
+  }
+  return 1;
+}
+
+/* temp_read_poll:
+   0 while the read started by temp_read_begin runs. Then 1 with the
+   register in *temp, 256 times the temperature in degrees Celsius,
+   or minus the I2C status if it failed and has to be started again;
+   -I2C_BUSY means the queue was full. */
+int temp_read_poll(int16_t *temp)
+{
+  i2c_service();
+  if (temp_state > 0)
+    *temp = temp_value;
+  return temp_state;
+}
+
+/* temp_mode:
+   Set the resolution, 9 to 12 bits, and whether the sensor converts
+   continuously or only when temp_sample_begin asks (oneshot), sleeping
+   in between. The write is queued and read back; if it did not take,
+   the next temp_sample_begin sends it again. Nothing is sent when the
+   sensor is known to be in that mode already. Returns 0 if the last
+   one is still on its way or the I2C queue is full. */
+int temp_mode(int bits, int oneshot)
+{
+  uint8_t conf;
+
+  if (temp_conf_state == 0)
+    return 0;
+  if (bits < 9)
+    bits = 9;
+  if (bits > 12)
+    bits = 12;
+  conf = (bits - 9) << TEMP_CONF_RES_SHIFT | temp_alert_conf;
+  if (oneshot)
+    conf |= TEMP_CONF_SHUTDOWN;
+  if (temp_conf_known && conf == temp_conf[1])
+    return 1;
+  temp_bits = bits;
+  temp_oneshot = oneshot;
+  temp_conf[1] = conf;
+
+  temp_conf_known = 0;
+  temp_conf_state = 0;
+  if (!i2c_submit(temp_conf_desc, 2, temp_conf_done))
+  {
+    temp_conf_state = -1;
+    return 0;
+  }
+  /* The conversion running now may be at the old resolution */
+  temp_fresh = core_timer() + temp_conv_ticks();
+  return 1;
+}
+
+/* temp_whole:
+   With on set, reads only fetch the upper byte of the temperature
+   register, the whole degrees rounded down, and the fraction reads
+   as 0. That halves the bytes of a read, but only suits a caller
+   that wants the floor, like a comparison against a whole-degree
+   limit: the half-degree bit needed to round is in the lower byte,
+   so a readout that rounds to whole degrees must read both. */
+void temp_whole(int on)
+{
+  temp_whole_only = on;
+}
+
+/* temp_retry:
+   How many times temp_sample_poll tries a failed transfer of a
+   sample again before it gives up on it. */
+void temp_retry(int n)
+{
+  temp_retries = n < 0 ? 0 : n;
+}
+
+/* temp_conversion_ms:
+   How long a conversion takes in the current mode. */
+unsigned int temp_conversion_ms(void)
+{
+  return temp_conv_ms[temp_bits - 9];
+}
+
+/* temp_sample_begin:
+   Ask for a reading that is newer than the last one. In one-shot
+   mode this starts a conversion; when continuous, the sensor is only
+   read once it has finished the next one. temp_sample_poll takes it
+   from there. Returns 0 if a sample is already under way or the
+   I2C queue is full. */
+int temp_sample_begin(void)
+{
+  if (temp_phase != TEMP_IDLE)
+    return 0;
+  if (temp_conf_state < 0 && !temp_mode(temp_bits, temp_oneshot))
+    return 0;
+  if (temp_oneshot)
+  {
+    temp_trigger[1] = temp_conf[1] | TEMP_CONF_ONESHOT;
+    if (!i2c_submit(&temp_trigger_desc, 1, temp_trigger_done))
+      return 0;
+    temp_fresh = core_timer() + temp_conv_ticks();
+  }
+  temp_tries = 0;
+  temp_phase = TEMP_WAIT;
+  return 1;
+}
+
+/* temp_sample_poll:
+   Move the sample started by temp_sample_begin on: wait for the
+   conversion by the core timer, without touching the bus, then read
+   it. A failed trigger or read is tried again up to temp_retry
+   times. Returns 0 until it is done, then 1 with the register in
+   *temp like temp_read_poll, or minus the I2C status of the last
+   try if it failed, or -1 if none was started.
+
+   Each try ends within I2C_TIMEOUT_US of the bus going quiet, so a
+   sample takes at most a conversion plus the retries and one more
+   times a timed out transfer, whatever the sensor does. */
+int temp_sample_poll(int16_t *temp)
+{
+  int done;
+
+  i2c_service();
+  switch (temp_phase)
+  {
+  case TEMP_WAIT:
+    if (temp_oneshot && temp_trigger_desc.status > I2C_BUSY)
+    {
+      if (temp_tries < temp_retries &&
+          i2c_submit(&temp_trigger_desc, 1, temp_trigger_done))
+      {
+        temp_tries++;
+        temp_fresh = core_timer() + temp_conv_ticks();
+        return 0;
+      }
+      temp_phase = TEMP_IDLE;
+      return -temp_trigger_desc.status;
+    }
+    if ((int)(core_timer() - temp_fresh) < 0 || temp_trigger_desc.status == I2C_BUSY ||
+        !temp_read_begin())
+      return 0;
+    temp_phase = TEMP_READ;
+    return 0;
+
+  case TEMP_READ:
+    done = temp_read_poll(temp);
+    if (done == 0)
+      return 0;
+    if (done < 0 && temp_tries < temp_retries)
+    {
+      temp_tries++;
+      temp_read_begin();
+      return 0;
+    }
+    temp_phase = TEMP_IDLE;
+    /* Continuous conversions follow each other, so the next one is
+       done at most a conversion time from now */
+    if (done > 0 && !temp_oneshot)
+      temp_fresh = core_timer() + temp_conv_ticks();
+    return done;
+  }
+  return -1;
+}
+
+/* Several sensors. A TCN75A takes one of the eight addresses from
+   TEMP_SENSOR_ADDR by its A2..A0 pins. temp_scan finds the ones on
+   the bus, and temp_poll reads all of them in one batch, back to back
+   with repeated starts, once per conversion. A channel is a sensor
+   found by the scan, in address order. The main sensor is left out
+   of the batch: its mode and reads are temp_sample's, and its
+   channel gives the last of those. */
+static uint8_t temp_chan_index[TEMP_CHANNEL_MAX]; /* Address - TEMP_SENSOR_ADDR */
+static int temp_chan_count;
+
+static int16_t temp_chan_value[TEMP_CHANNEL_MAX];
+static volatile int8_t temp_chan_state[TEMP_CHANNEL_MAX]; /* As temp_state, 0 before the first read */
+
+static uint8_t temp_chan_buf[TEMP_CHANNEL_MAX][2];
+static struct i2c_desc temp_chan_desc[TEMP_CHANNEL_MAX];
+
+/* Configuration the scan writes, one per address */
+static uint8_t temp_scan_conf[2] = {TEMP_SENSOR_REG_CONF, 0x0};
+static int temp_scan_bits = 9;
+
+/* 1 while a scan or poll batch runs, and when the next poll is due */
+static volatile int temp_poll_busy;
+static unsigned int temp_poll_due;
+
+static void temp_scan_done(struct i2c_desc *d, int n)
+{
+  int i;
+
+  temp_chan_count = 0;
+  for (i = 0; i < n; i++)
+    if (d[i].status == I2C_OK)
+    {
+      temp_pointer[i] = TEMP_SENSOR_REG_CONF;
+      temp_chan_index[temp_chan_count] = i;
+      temp_chan_state[temp_chan_count++] = 0;
+    }
+    else
+      temp_pointer[i] = TEMP_POINTER_UNKNOWN;
+  temp_poll_busy = 0;
+}
+
+/* Channel 0 is the main sensor's when the scan found it */
+static int temp_poll_first(void)
+{
+  return temp_chan_count > 0 && temp_chan_index[0] == 0;
+}
+
+static void temp_poll_done(struct i2c_desc *d, int n)
+{
+  int ch, i;
+
+  for (ch = d - temp_chan_desc; n > 0; ch++, d++, n--)
+  {
+    i = temp_chan_index[ch];
+    if (d->status == I2C_OK)
+    {
+      temp_chan_value[ch] = (temp_chan_buf[ch][0] << 8) | temp_chan_buf[ch][1];
+      temp_pointer[i] = TEMP_SENSOR_REG_TEMP;
+      temp_chan_state[ch] = 1;
+    }
+    else
+    {
+      temp_pointer[i] = TEMP_POINTER_UNKNOWN;
+      temp_chan_state[ch] = -d->status;
+    }
+  }
+  temp_poll_busy = 0;
+}
+
+/* temp_scan:
+   Look for sensors at all eight addresses, and set the ones that
+   answer to continuous conversions at bits of resolution. Waits for
+   the bus, so it works before interrupts are on. Returns how many
+   were found, or -1 if the I2C queue is full. A sensor the scan
+   did not find is never polled. */
+int temp_scan(int bits)
+{
+  int i;
+
+  if (bits < 9)
+    bits = 9;
+  if (bits > 12)
+    bits = 12;
+  while (temp_poll_busy)
+    i2c_service();
+
+  temp_scan_bits = bits;
+  temp_scan_conf[1] = (bits - 9) << TEMP_CONF_RES_SHIFT;
+  for (i = 0; i < TEMP_CHANNEL_MAX; i++)
+  {
+    temp_chan_desc[i].addr = TEMP_SENSOR_ADDR + i;
+    temp_chan_desc[i].wlen = 2;
+    temp_chan_desc[i].rlen = 0;
+    temp_chan_desc[i].w = temp_scan_conf;
+    temp_chan_desc[i].r = 0;
+  }
+  /* The main sensor's mode is temp_mode's to keep */
+  temp_conf_known = 0;
+
+  temp_poll_busy = 1;
+  if (!i2c_submit(temp_chan_desc, TEMP_CHANNEL_MAX, temp_scan_done))
+  {
+    temp_poll_busy = 0;
+    return -1;
+  }
+  while (temp_poll_busy)
+    i2c_service();
+  temp_poll_due = core_timer() + temp_conv_ms[bits - 9] * (CORE_TIMER_HZ / 1000);
+  return temp_chan_count;
+}
+
+/* temp_poll:
+   Read every channel but the main sensor's once a conversion is done
+   since the last round.
+   Call it often; it returns at once while the last round is on the
+   bus or the sensors are converting. */
+void temp_poll(void)
+{
+  static const uint8_t reg = TEMP_SENSOR_REG_TEMP;
+  int ch, first = temp_poll_first();
+
+  i2c_service();
+  if (temp_chan_count == first || temp_poll_busy || (int)(core_timer() - temp_poll_due) < 0)
+    return;
+
+  for (ch = first; ch < temp_chan_count; ch++)
+  {
+    temp_chan_desc[ch].addr = TEMP_SENSOR_ADDR + temp_chan_index[ch];
+    temp_chan_desc[ch].wlen = temp_pointer_len(temp_chan_index[ch]);
+    temp_chan_desc[ch].rlen = 2;
+    temp_chan_desc[ch].w = &reg;
+    temp_chan_desc[ch].r = temp_chan_buf[ch];
+  }
+  temp_poll_busy = 1;
+  if (!i2c_submit(&temp_chan_desc[first], temp_chan_count - first, temp_poll_done))
+  {
+    temp_poll_busy = 0;
+    return;
+  }
+  temp_poll_due = core_timer() + temp_conv_ms[temp_scan_bits - 9] * (CORE_TIMER_HZ / 1000);
+}
+
+/* temp_channels:
+   How many sensors the last scan found. */
+int temp_channels(void)
+{
+  return temp_chan_count;
+}
+
+/* temp_channel_addr:
+   The bus address of channel ch. */
+int temp_channel_addr(int ch)
+{
+  return TEMP_SENSOR_ADDR + temp_chan_index[ch];
+}
+
+/* temp_channel_read:
+   The latest reading of channel ch in *temp, as temp_read_poll gives
+   it. Returns 1 if the last read of it went well, 0 if it has not
+   been read yet, and minus its I2C status if the last read failed;
+   *temp then keeps the reading before. */
+int temp_channel_read(int ch, int16_t *temp)
+{
+  if (ch < 0 || ch >= temp_chan_count)
+    return -1;
+  if (ch == 0 && temp_poll_first())
+  {
+    if (temp_last_state != 0)
+      *temp = temp_value;
+    return temp_last_state;
+  }
+  *temp = temp_chan_value[ch];
+  return temp_chan_state[ch];
+}
+
+/* Alerts. The main sensor's ALERT output, active low, is on RD8,
+   which is also INT1. The sensor compares every conversion with
+   T_SET and T_HYST itself, so an alert costs nothing on the bus
+   until it fires.
+
+   The shield wires SW1 to RD8 as well. SW1 has to stay off (down)
+   for RD8 to follow ALERT; flipped on, it holds the line and fires
+   INT1 like an alert would. The firmware does not read SW1. */
+#define TEMP_ALERT_PIN (1 << 8) /* RD8 */
+#define INT1_IRQ_MASK (1 << 7)  /* IFS0/IEC0 */
+#define INT1_IPC_SHIFT 26       /* IPC1<28:26> */
+#define INT1_PRIORITY 3
+#define INTCON_INT1EP 0x02 /* INT1 on the rising edge, not the falling */
+
+/* T_HYST and T_SET writes: pointer, then the 9-bit value left-aligned */
+static uint8_t temp_alert_w[2][3] = {
+    {TEMP_SENSOR_REG_HYST, 0, 0},
+    {TEMP_SENSOR_REG_LIMIT, 0, 0},
+};
+static struct i2c_desc temp_alert_desc[2] = {
+    {TEMP_SENSOR_ADDR, 3, 0, I2C_OK, temp_alert_w[0], 0},
+    {TEMP_SENSOR_ADDR, 3, 0, I2C_OK, temp_alert_w[1], 0},
+};
+
+/* In interrupt mode the output stays asserted until any register is
+   read. One byte from wherever the pointer is does that. */
+static uint8_t temp_alert_byte;
+static struct i2c_desc temp_alert_ack = {TEMP_SENSOR_ADDR, 0, 1, I2C_OK, 0, &temp_alert_byte};
+
+static volatile int temp_alert_on;
+static volatile unsigned int temp_alert_events;
+
+static void temp_alert_written(struct i2c_desc *d, int n)
+{
+  if (d[0].status == I2C_OK && d[1].status == I2C_OK)
+    temp_pointer[0] = TEMP_SENSOR_REG_LIMIT;
+  else
+    temp_pointer[0] = TEMP_POINTER_UNKNOWN;
+  temp_alert_busy = 0;
+}
+
+/* temp_alert_set:
+   Have the main sensor assert its alert output when the temperature
+   goes over limit, until it is back under hyst, both in the register
+   format of temp_read_poll and rounded down to half degrees. With
+   interrupt set, the sensor signals crossing each of them once;
+   otherwise the output follows the comparison. Either way
+   temp_alert_isr runs on every change. Returns 0 if the last
+   configuration is still on its way or the I2C queue is full. */
+int temp_alert_set(int16_t limit, int16_t hyst, int interrupt)
+{
+  if (temp_conf_state == 0 || temp_alert_busy)
+    return 0;
+  temp_alert_w[0][1] = hyst >> 8;
+  temp_alert_w[0][2] = hyst & 0x80;
+  temp_alert_w[1][1] = limit >> 8;
+  temp_alert_w[1][2] = limit & 0x80;
+  temp_alert_busy = 1;
+  if (!i2c_submit(temp_alert_desc, 2, temp_alert_written))
+  {
+    temp_alert_busy = 0;
+    return 0;
+  }
+
+  /* The mode bits go out with the rest of the configuration */
+  temp_alert_conf = interrupt ? TEMP_CONF_INT_MODE : 0;
+  temp_conf_known = 0;
+  temp_mode(temp_bits, temp_oneshot);
+
+  /* Falling edge first: the output is low while asserted */
+  temp_alert_on = 0;
+  INTCONCLR = INTCON_INT1EP;
+  IPCCLR(1) = 0x1F << 24;
+  IPCSET(1) = INT1_PRIORITY << INT1_IPC_SHIFT;
+  IFSCLR(0) = INT1_IRQ_MASK;
+  IECSET(0) = INT1_IRQ_MASK;
+  /* Asserted already, from before: no edge is coming for that */
+  if (!(PORTD & TEMP_ALERT_PIN))
+    IFSSET(0) = INT1_IRQ_MASK;
+  return 1;
+}
+
+/* temp_alert_active:
+   1 while the temperature is over the limit set by temp_alert_set,
+   until it has come back under the hysteresis. */
+int temp_alert_active(void)
+{
+  return temp_alert_on;
+}
+
+/* temp_alert_count:
+   How many times the alert has changed since start-up. */
+unsigned int temp_alert_count(void)
+{
+  return temp_alert_events;
+}
+
+/* temp_alert_isr:
+   INT1 handler, called from user_isr when the alert output changes.
+   Updates temp_alert_active and waits for the opposite edge. */
+void temp_alert_isr(void)
+{
+  int low;
+
+  IFSCLR(0) = INT1_IRQ_MASK;
+  low = !(PORTD & TEMP_ALERT_PIN);
+  if (temp_alert_conf & TEMP_CONF_INT_MODE)
+  {
+    /* Each assertion is one crossing, over the limit or back under
+       the hysteresis; a read lets the output go again */
+    if (low)
+    {
+      temp_alert_on = !temp_alert_on;
+      temp_alert_events++;
+      if (temp_alert_ack.status != I2C_BUSY)
+        i2c_submit(&temp_alert_ack, 1, 0);
+    }
+  }
+  else if (low != temp_alert_on)
+  {
+    temp_alert_on = low;
+    temp_alert_events++;
+  }
+
+  if (low)
+    INTCONSET = INTCON_INT1EP;
+  else
+    INTCONCLR = INTCON_INT1EP;
+  /* An edge between reading the pin and turning INT1 round is lost,
+     so look again */
+  if (low != !(PORTD & TEMP_ALERT_PIN))
+    IFSSET(0) = INT1_IRQ_MASK;
+}
+
+/* Benchmark. Full reads of the main sensor's temperature register,
+   pointer written every time, in batches of I2C_BENCH_DESC kept two
+   deep in the queue so the bus never waits for the CPU. */
+#define I2C_BENCH_DESC 4
+#define I2C_BENCH_BATCHES 32
+#define I2C_BENCH_BYTES 5 /* Address, pointer, address, two bytes */
+
+static struct i2c_desc i2c_bench_desc[2][I2C_BENCH_DESC];
+static uint8_t i2c_bench_buf[2];
+static volatile int i2c_bench_busy[2];
+static volatile unsigned int i2c_bench_ok;
+
+static void i2c_bench_done(struct i2c_desc *d, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (d[i].status == I2C_OK)
+      i2c_bench_ok++;
+  i2c_bench_busy[d == i2c_bench_desc[1]] = 0;
+}
+
+/* i2c_benchmark:
+   Read the main sensor I2C_BENCH_DESC * I2C_BENCH_BATCHES times as
+   fast as the bus allows at I2C1_HZ, and report the reads that went
+   well per second and the bytes per second they moved. Waits for
+   the queue to empty first, and works with interrupts on or off. */
+void i2c_benchmark(unsigned int *tps, unsigned int *bps)
+{
+  static const uint8_t reg = TEMP_SENSOR_REG_TEMP;
+  unsigned int t0, us;
+  int i, set, sent = 0;
+
+  while (i2c_count > 0)
+    i2c_service();
+  for (set = 0; set < 2; set++)
+    for (i = 0; i < I2C_BENCH_DESC; i++)
+    {
+      i2c_bench_desc[set][i].addr = TEMP_SENSOR_ADDR;
+      i2c_bench_desc[set][i].wlen = 1;
+      i2c_bench_desc[set][i].rlen = 2;
+      i2c_bench_desc[set][i].w = &reg;
+      i2c_bench_desc[set][i].r = i2c_bench_buf;
+    }
+  i2c_bench_ok = 0;
+
+  t0 = core_timer();
+  while (sent < I2C_BENCH_BATCHES || i2c_bench_busy[0] || i2c_bench_busy[1])
+  {
+    set = sent & 1;
+    if (sent < I2C_BENCH_BATCHES && !i2c_bench_busy[set])
+    {
+      i2c_bench_busy[set] = 1;
+      if (i2c_submit(i2c_bench_desc[set], I2C_BENCH_DESC, i2c_bench_done))
+        sent++;
+      else
+        i2c_bench_busy[set] = 0;
+    }
+    i2c_service();
+  }
+  us = (core_timer() - t0) / (CORE_TIMER_HZ / 1000000);
+  temp_pointer[0] = TEMP_POINTER_UNKNOWN;
+
+  if (us == 0)
+    us = 1;
+  *tps = i2c_bench_ok * 1000000 / us;
+  *bps = i2c_bench_ok * I2C_BENCH_BYTES * 1000000 / us;
+}
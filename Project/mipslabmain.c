@@ -17,9 +17,6 @@
 #include <float.h>
 #include <stdlib.h>
 
-/* Address of the temperature sensor on the I2C bus */
-#define TEMP_SENSOR_ADDR 0x48
-
 int tOutCount = 0;
 int units = 0;
 int type = 0;
@@ -32,6 +29,9 @@ int sTemp = 0;
 int continuous = 1; // pre set to show continuous temperature value
 int average = 0;	// for showing average measurments
 int timer = 10;		// timer for measuring pre set to 10s
+int sensorCount = 0;	// sensors the bus scan found at start-up
+int shownChannel = 0;	// the extra sensor line 2 shows now
+int sensorError = 0;	// I2C status of the last failed reading, 0 when it worked
 
 char textstring[] = "text, more text, and even more text!";
 #define TIME2PERIOD ((80000000 / 256) / 10); // the chipkit has a freq. of 80MHz and we're
@@ -45,31 +45,11 @@ volatile int *port_E;
 void measurementType(void);
 void menu(void);
 void setTime(void);
-
-/*
-	Math.h doesn't work so we need to implement pow ourselves.
-*/
-int pow(int base, int exponent)
-{
-	int i;
-	int result = 1;
-	if (exponent == 0)
-	{
-		result = 1;
-	}
-	else
-	{
-		for (i = 0; i < exponent; i++)
-		{
-			result = result * base;
-		}
-	}
-	return result;
-}
+float toUnit(float degrees);
 
 /*
 Interrupt Service Routine
-Could probably delete this since we don\t use interrupts
+Every interrupt ends up here, so check which enabled source raised its flag
 */
 void user_isr(void)
 {
@@ -79,6 +59,19 @@ void user_isr(void)
 
 		IFSCLR(0) = 0x00000100; // Clear the timer interrupt status flag
 	}
+	if (IEC(1) & IFS(1) & (1 << 6))
+	{ // SPI2 TX buffer empty, feed the next display byte
+		display_isr();
+	}
+	if (IEC(0) & IFS(0) & (1u << 31))
+	{ // I2C1 master event, start the next step of the sensor transfer
+		i2c_isr();
+	}
+	if (IEC(0) & IFS(0) & 0x80)
+	{ // INT1, the sensor's alert output changed: all LEDs on while it is too warm
+		temp_alert_isr();
+		PORTE = temp_alert_active() ? 0xFF : 0x00;
+	}
 }
 
 /*
@@ -119,739 +112,262 @@ void init(void)
 	return;
 }
 
-/* Temperature sensor internal registers */
-typedef enum TempSensorReg TempSensorReg;
-enum TempSensorReg
-{
-	TEMP_SENSOR_REG_TEMP,
-	TEMP_SENSOR_REG_CONF,
-	TEMP_SENSOR_REG_HYST,
-	TEMP_SENSOR_REG_LIMIT,
-};
-/* Wait for I2C bus to become idle */
-void i2c_idle()
-{
-	while (I2C1CON & 0x1F || I2C1STAT & (1 << 14))
-		; // TRSTAT
-}
-
-/* Send one byte on I2C bus, return ack/nack status of transaction */
-bool i2c_send(uint8_t data)
-{
-	i2c_idle();
-	I2C1TRN = data;
-	i2c_idle();
-	return !(I2C1STAT & (1 << 15)); // ACKSTAT
-}
-
-/* Receive one byte from I2C bus */
-uint8_t i2c_recv()
-{
-	i2c_idle();
-	I2C1CONSET = 1 << 3; // RCEN = 1
-	i2c_idle();
-	I2C1STATCLR = 1 << 6; // I2COV = 0
-	return I2C1RCV;
-}
-
-/* Send acknowledge conditon on the bus */
-void i2c_ack()
-{
-	i2c_idle();
-	I2C1CONCLR = 1 << 5; // ACKDT = 0
-	I2C1CONSET = 1 << 4; // ACKEN = 1
-}
-
-/* Send not-acknowledge conditon on the bus */
-void i2c_nack()
-{
-	i2c_idle();
-	I2C1CONSET = 1 << 5; // ACKDT = 1
-	I2C1CONSET = 1 << 4; // ACKEN = 1
-}
-
-/* Send start conditon on the bus */
-void i2c_start()
-{
-	i2c_idle();
-	I2C1CONSET = 1 << 0; // SEN
-	i2c_idle();
-}
-
-/* Send restart conditon on the bus */
-void i2c_restart()
-{
-	i2c_idle();
-	I2C1CONSET = 1 << 1; // RSEN
-	i2c_idle();
-}
-
-/* Send stop conditon on the bus */
-void i2c_stop()
-{
-	i2c_idle();
-	I2C1CONSET = 1 << 2; // PEN
-	i2c_idle();
-}
-
 /*converts the temperature retrived from the sensor that is stored in a int16_t to a float so that we easier can
 convert between units.
 */
 float convertInt16(int16_t temp)
 {
-	float upper = temp >> 8;			  // the eight upper bit contains the value in front of the decimal point so we need to shift them.
-	int16_t tempL = (temp & 0x00f0) >> 4; // bit 7-4 contains our decimal value so we mask everything else and then shift it right.
-	float tiondel = 0;
-	float hundradel = 0;
-	float tusendel = 0;
-	float tiotusendel = 0;
-	// converts the hexadecimal representation of the number after the decimal point into decimal representation according to the
-	// TCN75A 2-Wire Serial Temperature Sensor reference sheet (DS21935C) page 13.
-	if (tempL & 0x8)
-	{
-		tiondel = 1 / 2;
-	}
-	if (tempL & 4)
-	{
-		hundradel = 1 / (pow(2, 2));
-	}
-	if (tempL & 2)
+	// the upper byte holds the whole degrees and the lower byte the fraction, so the
+	// register is the temperature in 1/256 degrees. See the TCN75A 2-Wire Serial
+	// Temperature Sensor reference sheet (DS21935C) page 13.
+	return temp / 256.0f;
+}
+/* Resolution of the readings the loops show, in bits. 12 bits is 1/16 degree,
+the step the trend chart and the histogram use, and takes up to 600 ms a reading. */
+#define SENSOR_BITS 12
+/* At start-up 9 bits, so the first reading is ready while the display powers up */
+#define SENSOR_BOOT_BITS 9
+/* Degrees Celsius over which the sensor raises its alert, lighting the LEDs
+(with switch 1 off, as it shares the alert line),
+and under which it takes it back */
+#define ALERT_LIMIT 30
+#define ALERT_HYST 28
+
+/* Waits for the reading started by temp_sample_begin or sensorStart. The wait is
+timed by the core timer until the sensor has converted, so the bus is only used
+for the read itself. The driver tries a failed read again a few times; if it
+still fails, sensorError gets its I2C status and the last good reading comes
+back, so an unplugged sensor only costs the timeouts of those tries.
+*/
+int16_t sensorWait(void)
+{
+	static int16_t last; // the last good reading
+	int16_t temp;
+	int done;
+
+	while ((done = temp_sample_poll(&temp)) == 0)
 	{
-		tusendel = 1 / (pow(2, 3));
+		temp_poll(); // the other sensors are read while we wait
 	}
-	if (tempL & 1)
+	if (done < 0)
 	{
-		tiotusendel = 1 / (pow(2, 4));
+		sensorError = -done;
+		return last;
 	}
-	float lower = (tiondel + hundradel + tusendel + tiotusendel);
-	float fTemp = upper + lower;
-
-	return fTemp;
+	sensorError = 0;
+	last = temp;
+	return temp;
 }
-/*
-The following three functions (reverse, intToString and ftoa) is taken from https://www.geeksforgeeks.org/convert-floating-point-number-string/
- although with some changes
+
+/* Sets the sensor's resolution and whether it converts all the time or one
+reading at a time, sleeping in between, and starts the first reading with
+its fraction. sensorWait gets it. Nothing is sent if the sensor is in that
+mode already.
 */
-// Reverses a string 'str' of length 'len'
-void reverse(char *str, int len)
+void sensorStart(int bits, int oneShot)
 {
-	int i = 0, j = len - 1, temp; // initialze int variables
-	while (i < j)				  // loop until the end
+	while (!temp_mode(bits, oneShot))
 	{
-		// shift the string
-		temp = str[i];
-		str[i] = str[j];
-		str[j] = temp;
-		i++;
-		j--;
+		i2c_service(); // the last mode is still on its way
 	}
+	temp_sample_begin();
 }
 
-/* Converts a given integer x to string str[].
- digits is the number of digits required in the output.
- If digits is more than the number of digits in x then 0s are added at the beginning.
- */
-int intToStr(int x, char str[], int digits)
+/* Returns the unit to print after a temperature */
+const char *unitSuffix(void)
 {
-	int i = 0;
-	while (x)
+	if (kelvin == 1)
 	{
-		str[i++] = (x % 10) + '0';
-		x = x / 10;
+		return " K";
 	}
+	return celcius == 1 ? "\xB0" "C" : "\xB0" "F";
+}
 
-	// If number of digits required is more, then
-	// add 0s at the beginning
-	while (i < digits)
-	{
-		str[i++] = '0';
-	}
-	/* We check our global variable to see what unit should be printed
-	 */
-	if (digits == 0 && kelvin == 1 && celcius == 0 && farenheit == 0)
+/* Shows the sensors besides the main one on line 2, the next one each time,
+with the latest reading the poller has of it.
+*/
+void showChannels(void)
+{
+	int16_t temp;
+
+	temp_poll();
+	if (sensorCount < 2)
 	{
-		str[i++] = ' ';
-		str[i++] = 'K';
+		return;
 	}
-	else if (digits == 0 && celcius == 1 && kelvin == 0 && farenheit == 0)
+	shownChannel = shownChannel % (sensorCount - 1) + 1;
+	if (temp_channel_read(shownChannel, &temp) > 0)
 	{
-		str[i++] = ' ';
-		str[i++] = 'C';
+		display_printf(2, "Probe %d %.1f%s", shownChannel + 1, toUnit(convertInt16(temp)), unitSuffix());
 	}
-	else if (digits == 0 && farenheit == 1)
+	else
 	{
-		str[i++] = ' ';
-		str[i++] = 'F';
+		display_printf(2, "Probe %d --", shownChannel + 1);
 	}
-	reverse(str, i);
-	str[i] = '\0';
-	return i;
 }
 
-// Converts a floating-point/double number to a string.
-void ftoa(float n, char *res, int afterpoint)
+/* Shows a reading with its unit in the continuous loops. Switch 2 up plots
+the trend chart, switch 3 or 4 up shows the reading in 2x or 3x digits,
+otherwise it goes on text line 1 with the other sensors on line 2.
+*/
+void showReading(float value)
 {
-	// Extract integer part
-	int ipart = (int)n;
+	int sw = getsw();
+	char big[8];
 
-	// Extract floating part
-	float fpart = n - (float)ipart;
-
-	// convert integer part to string
-	int i = intToStr(ipart, res, 0);
-
-	// check for display option after point
-	if (afterpoint != 0)
+	if (sensorError != 0)
 	{
-		res[i] = '.'; // add dot
-
-		// Get the value of fraction part upto given no.
-		// of points after dot. The third parameter
-		// is needed to handle cases like 233.007
-		fpart = fpart * pow(10, afterpoint);
-
-		intToStr((int)fpart, res + i + 1, afterpoint);
+		trend_end();
+		bignum_end();
+		display_printf(1, "Sensor error %d", sensorError);
+		display_update_async();
+		return;
 	}
-}
-
-// gives us the temperature in kelvin continuously
-void getKelvinTemperature(void)
-{
-	int16_t temp;	  // where we will store the data coming from the sensor
-	char buf[32], *s; // needed when we want to convert our data from a float to a char*
-
-	/* Send start condition and address of the temperature sensor with
-	write mode (lowest bit = 0) until the temperature sensor sends
-	acknowledge condition */
-	do
+	if (sw & 0x2)
 	{
-		i2c_start();
-	} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-	/* Send register number we want to access */
-	i2c_send(TEMP_SENSOR_REG_CONF);
-	/* Set the config register to 0 */
-	i2c_send(0x0);
-	/* Send stop condition */
-	i2c_stop();
-
-	for (;;)
-	{
-
-		int buttons = getbtns();
-		/* Send start condition and address of the temperature sensor with
-		write flag (lowest bit = 0) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-		/* Send register number we want to access */
-		i2c_send(TEMP_SENSOR_REG_TEMP);
-
-		/* Now send another start condition and address of the temperature sensor with
-		read mode (lowest bit = 1) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send((TEMP_SENSOR_ADDR << 1) | 1));
-
-		/* Now we can start receiving data from the sensor data register */
-		temp = i2c_recv() << 8;
-		i2c_ack();
-		temp |= i2c_recv();
-		/* To stop receiving, send nack and stop */
-		i2c_nack();
-		i2c_stop();
-		// T(K) = T(°C) + 273.15
-
-		// if (kelvin == 1)
-		// {
-		float fKelvin = 273.15 + convertInt16(temp);
-		ftoa(fKelvin, buf, 0);
-		//}
-
-		if (getbtn1() & 0x200)
-		{
-			sTemp = 0;
-			break;
-		}
-		display_string(1, s); // temperature string
-
-		display_update();
-		quicksleep(500000);
-		//  delay(1000000);
+		bignum_end();
+		trend_push(value * 16);
+		return;
 	}
-}
-
-void getCelciusTemperature(void)
-{
-	int16_t temp;
-	char buf[32], *s;
-	/* Send start condition and address of the temperature sensor with
-	write mode (lowest bit = 0) until the temperature sensor sends
-	acknowledge condition */
-	do
+	trend_end();
+	if (sw & 0xC)
 	{
-		i2c_start();
-	} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-	/* Send register number we want to access */
-	i2c_send(TEMP_SENSOR_REG_CONF);
-	/* Set the config register to 0 */
-	i2c_send(0x0);
-	/* Send stop condition */
-	i2c_stop();
-
-	for (;;)
+		// whole degrees in 3x, so that "-10\xB0C" still fits
+		format_string(big, sizeof(big), (sw & 0x8) ? "%.0f%s" : "%.1f%s", value, unitSuffix());
+		bignum_show(1, big, (sw & 0x8) ? 3 : 2);
+	}
+	else
 	{
-
-		int buttons = getbtns();
-		/* Send start condition and address of the temperature sensor with
-		write flag (lowest bit = 0) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-		/* Send register number we want to access */
-		i2c_send(TEMP_SENSOR_REG_TEMP);
-
-		/* Now send another start condition and address of the temperature sensor with
-		read mode (lowest bit = 1) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send((TEMP_SENSOR_ADDR << 1) | 1));
-
-		/* Now we can start receiving data from the sensor data register */
-		temp = i2c_recv() << 8;
-		i2c_ack();
-		temp |= i2c_recv();
-		/* To stop receiving, send nack and stop */
-		i2c_nack();
-		i2c_stop();
-		// T(K) = T(°C) + 273.15
-
-		// if (kelvin == 1)
-		// {
-		float fCelcius = convertInt16(temp);
-		ftoa(fCelcius, buf, 0);
-		//}
-
-		if (getbtn1() & 0x200)
-		{
-			sTemp = 0;
-			break;
-		}
-		display_string(1, s); // temperature string
-
-		display_update();
-		quicksleep(500000);
-		//  delay(1000000);
+		bignum_end();
+		display_printf(1, "%.1f%s", value, unitSuffix()); // temperature string
+		showChannels();
 	}
+	display_update_async(); // the display is sent while we sleep
 }
 
-void getFarenheitTemperature(void)
+// gives us the temperature in the selected unit continuously
+void getTemperature(void)
 {
-	int16_t temp;
-	char buf[32], *s;
-	/* Send start condition and address of the temperature sensor with
-	write mode (lowest bit = 0) until the temperature sensor sends
-	acknowledge condition */
-	do
-	{
-		i2c_start();
-	} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-	/* Send register number we want to access */
-	i2c_send(TEMP_SENSOR_REG_CONF);
-	/* Set the config register to 0 */
-	i2c_send(0x0);
-	/* Send stop condition */
-	i2c_stop();
+	int16_t temp; // where we will store the data coming from the sensor
 
+	/* Continuous 12-bit conversions and the first reading; the rest are
+	started just before the loop sleeps */
+	sensorStart(SENSOR_BITS, 0);
 	for (;;)
 	{
-
-		int buttons = getbtns();
-		/* Send start condition and address of the temperature sensor with
-		write flag (lowest bit = 0) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-		/* Send register number we want to access */
-		i2c_send(TEMP_SENSOR_REG_TEMP);
-
-		/* Now send another start condition and address of the temperature sensor with
-		read mode (lowest bit = 1) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send((TEMP_SENSOR_ADDR << 1) | 1));
-
-		/* Now we can start receiving data from the sensor data register */
-		temp = i2c_recv() << 8;
-		i2c_ack();
-		temp |= i2c_recv();
-		/* To stop receiving, send nack and stop */
-		i2c_nack();
-		i2c_stop();
-		// T(°F) = T(°C) × 1.8 + 32
-
-		// if (kelvin == 1)
-		// {
-		float fFarenheit = convertInt16(temp) * 1.8 + 32;
-		ftoa(fFarenheit, buf, 0);
-		//}
+		/* Wait for the reading, which came in from the I2C interrupt
+		while we slept */
+		temp = sensorWait();
 
 		if (getbtn1() & 0x200)
 		{
 			sTemp = 0;
+			trend_end();
+			bignum_end();
 			break;
 		}
-		display_string(1, buf); // temperature string
-
-		display_update();
+		showReading(toUnit(convertInt16(temp)));
+		temp_sample_begin(); // the next reading is read while we sleep
 		quicksleep(500000);
-		//  delay(1000000);
 	}
 }
 
-void celciusAverage(int time)
+/* Converts a temperature in degrees Celcius to the selected unit */
+float toUnit(float degrees)
 {
-
-	int16_t temp;
-	char buf[32], *s;
-	char bufMin[32], *t;
-	char bufMax[32], *v;
-	float counter = 0;
-	float test = 1;
-	float sum = 0;
-	float values[3000];
-	int p = 0;
-	for (p; p < 300; p++)
-	{
-		values[p] = 0.0f;
-	}
-	int i = 0;
-
-	while (getbtn1() != 0)
-	{
-	}
-	/* Send start condition and address of the temperature sensor with
-	write mode (lowest bit = 0) until the temperature sensor sends
-	acknowledge condition */
-	do
+	if (kelvin == 1)
 	{
-		i2c_start();
-	} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-	/* Send register number we want to access */
-	i2c_send(TEMP_SENSOR_REG_CONF);
-	/* Set the config register to 0 */
-	i2c_send(0x0);
-	/* Send stop condition */
-	i2c_stop();
-
-	while (time > counter)
-	{
-
-		/* Send start condition and address of the temperature sensor with
-		write flag (lowest bit = 0) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-		/* Send register number we want to access */
-		i2c_send(TEMP_SENSOR_REG_TEMP);
-
-		/* Now send another start condition and address of the temperature sensor with
-		read mode (lowest bit = 1) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send((TEMP_SENSOR_ADDR << 1) | 1));
-
-		/* Now we can start receiving data from the sensor data register */
-		temp = i2c_recv() << 8;
-		i2c_ack();
-		temp |= i2c_recv();
-		/* To stop receiving, send nack and stop */
-		i2c_nack();
-		i2c_stop();
-		// currentT = convertInt16(temp);
-		sum = sum + convertInt16(temp); // convert the data from temp. sensor to float
-		values[i++] = convertInt16(temp);
-		test++;
-
-		if (getbtn1() & 0x200)
-		{
-			sTemp = 0;
-			menu();
-			return;
-		}
-		counter = counter + 1;
-		quicksleep(3500000);
+		return 273.15 + degrees; // T(K) = T(°C) + 273.15
 	}
-	float min = values[0];
-	float max = values[0];
-	int j = 1;
-	while (values[j] != 0.00)
+	if (farenheit == 1)
 	{
-		if (min > values[j])
-		{
-			min = values[j];
-		}
-		if (max < values[j])
-		{
-			max = values[j];
-		}
-		j = j + 1;
+		return degrees * 1.8 + 32; // T(°F) = T(°C) × 1.8 + 32
 	}
-
-	sum = sum / counter;
-	ftoa(sum, buf, 0);
-	ftoa(min, bufMin, 0);
-	ftoa(max, bufMax, 0);
-	// ftoa(test, bufMin, 0); //displays how many times the while looped ran
-	display_string(0, buf);	   // average temp
-	display_string(1, bufMin); // min temp
-	display_string(2, bufMax); // min temp
-	display_string(3, "Back to menu");
-	display_update();
+	return degrees;
 }
 
-void kelvinAverage(int time)
+/* Measures for time readings and then shows the average, minimum and maximum.
+The readings go into a histogram that keeps those as they arrive, so nothing
+has to be stored and scanned afterwards. Switch 2 up shows the histogram while
+measuring, zoomed to the range of the readings shown on line 0.
+*/
+void showAverage(int time)
 {
-
 	int16_t temp;
-	char buf[32], *s;
-	char bufMin[32], *t;
-	char bufMax[32], *v;
-	float counter = 0;
-	float test = 1;
-	float sum = 0;
-	float values[3000];
-	int p = 0;
-	for (p; p < 300; p++)
-	{
-		values[p] = 0.0f;
-	}
-	int i = 0;
+	int counter = 0;
+	int n, min, max, sum;
 
 	while (getbtn1() != 0)
 	{
 	}
-	/* Send start condition and address of the temperature sensor with
-	write mode (lowest bit = 0) until the temperature sensor sends
-	acknowledge condition */
-	do
-	{
-		i2c_start();
-	} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-	/* Send register number we want to access */
-	i2c_send(TEMP_SENSOR_REG_CONF);
-	/* Set the config register to 0 */
-	i2c_send(0x0);
-	/* Send stop condition */
-	i2c_stop();
+	/* The readings are far apart, so the sensor converts one at a time
+	and sleeps in between */
+	sensorStart(SENSOR_BITS, 1);
+	hist_start();
 
 	while (time > counter)
 	{
-
-		/* Send start condition and address of the temperature sensor with
-		write flag (lowest bit = 0) until the temperature sensor sends
-		acknowledge condition */
-		do
+		temp = sensorWait();
+		if (sensorError == 0)
 		{
-			i2c_start();
-		} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-		/* Send register number we want to access */
-		i2c_send(TEMP_SENSOR_REG_TEMP);
+			hist_add(temp >> 4); // the register in sixteenths of a degree
+		}
 
-		/* Now send another start condition and address of the temperature sensor with
-		read mode (lowest bit = 1) until the temperature sensor sends
-		acknowledge condition */
-		do
+		if (getsw() & 0x2)
 		{
-			i2c_start();
-		} while (!i2c_send((TEMP_SENSOR_ADDR << 1) | 1));
-
-		/* Now we can start receiving data from the sensor data register */
-		temp = i2c_recv() << 8;
-		i2c_ack();
-		temp |= i2c_recv();
-		/* To stop receiving, send nack and stop */
-		i2c_nack();
-		i2c_stop();
-		// currentT = convertInt16(temp);
-		sum = sum + (273.15 + convertInt16(temp)); // convert the data from temp. sensor to float
-		values[i++] = 273.15 + convertInt16(temp);
-		test++;
+			hist_show();
+			hist_stats(&n, &min, &max, &sum);
+			if (n > 0)
+				display_printf(0, "%.1f..%.1f", toUnit(min / 16.0f), toUnit(max / 16.0f));
+			else
+				display_string(0, "--..--");
+			display_update_async();
+		}
+		else
+		{
+			hist_end();
+		}
 
 		if (getbtn1() & 0x200)
 		{
+			hist_end();
 			sTemp = 0;
 			menu();
 			return;
 		}
 		counter = counter + 1;
-		quicksleep(3500000);
-	}
-	float min = values[0];
-	float max = values[0];
-	int j = 1;
-	while (values[j] != 0.00)
-	{
-		if (min > values[j])
-		{
-			min = values[j];
-		}
-		if (max < values[j])
+		if (time > counter)
 		{
-			max = values[j];
+			temp_sample_begin(); // the next reading is taken while we sleep
 		}
-		j = j + 1;
+		quicksleep(3500000);
 	}
 
-	sum = sum / counter;
-	ftoa(sum, buf, 0);
-	ftoa(min, bufMin, 0);
-	ftoa(max, bufMax, 0);
-	// ftoa(test, bufMin, 0); //displays how many times the while looped ran
-	display_string(0, buf);	   // average temp
-	display_string(1, bufMin); // min temp
-	display_string(2, bufMax); // min temp
-	display_string(3, "Back to menu");
-	display_update();
-}
-
-void fahrenheitAverage(int time)
-{
-
-	int16_t temp;
-	char buf[32], *s;
-	char bufMin[32], *t;
-	char bufMax[32], *v;
-	float counter = 0;
-	float test = 1;
-	float sum = 0;
-	float values[3000];
-	int p = 0;
-	for (p; p < 300; p++)
+	hist_end();
+	hist_stats(&n, &min, &max, &sum);
+	if (n > 0)
 	{
-		values[p] = 0.0f;
+		display_printf(0, "Avr. %.1f%s", toUnit(sum / 16.0f / n), unitSuffix()); // average temp
+		display_printf(1, "Min. %.1f%s", toUnit(min / 16.0f), unitSuffix());	   // min temp
+		display_printf(2, "Max. %.1f%s", toUnit(max / 16.0f), unitSuffix());	   // max temp
 	}
-	int i = 0;
-
-	while (getbtn1() != 0)
+	else // every reading failed
 	{
+		display_string(0, "Avr. --");
+		display_string(1, "Min. --");
+		display_string(2, "Max. --");
 	}
-	/* Send start condition and address of the temperature sensor with
-	write mode (lowest bit = 0) until the temperature sensor sends
-	acknowledge condition */
-	do
-	{
-		i2c_start();
-	} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-	/* Send register number we want to access */
-	i2c_send(TEMP_SENSOR_REG_CONF);
-	/* Set the config register to 0 */
-	i2c_send(0x0);
-	/* Send stop condition */
-	i2c_stop();
-
-	while (time > counter)
-	{
-
-		/* Send start condition and address of the temperature sensor with
-		write flag (lowest bit = 0) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send(TEMP_SENSOR_ADDR << 1));
-		/* Send register number we want to access */
-		i2c_send(TEMP_SENSOR_REG_TEMP);
-
-		/* Now send another start condition and address of the temperature sensor with
-		read mode (lowest bit = 1) until the temperature sensor sends
-		acknowledge condition */
-		do
-		{
-			i2c_start();
-		} while (!i2c_send((TEMP_SENSOR_ADDR << 1) | 1));
-
-		/* Now we can start receiving data from the sensor data register */
-		temp = i2c_recv() << 8;
-		i2c_ack();
-		temp |= i2c_recv();
-		/* To stop receiving, send nack and stop */
-		i2c_nack();
-		i2c_stop();
-		// currentT = convertInt16(temp);
-		sum = sum + (convertInt16(temp) * 1.8 + 32); // convert the data from temp. sensor to float
-		values[i++] = convertInt16(temp) * 1.8 + 32;
-		test++;
-
-		if (getbtn1() & 0x200)
-		{
-			sTemp = 0;
-			menu();
-			return;
-		}
-		counter = counter + 1;
-		quicksleep(3500000);
-	}
-	float min = values[0];
-	float max = values[0];
-	int j = 1;
-	while (values[j] != 0.00)
-	{
-		if (min > values[j])
-		{
-			min = values[j];
-		}
-		if (max < values[j])
-		{
-			max = values[j];
-		}
-		j = j + 1;
-	}
-
-	sum = sum / counter;
-	ftoa(sum, buf, 0);
-	ftoa(min, bufMin, 0);
-	ftoa(max, bufMax, 0);
-	// ftoa(test, bufMin, 0); //displays how many times the while looped ran
-	display_string(0, buf);	   // average temp
-	display_string(1, bufMin); // min temp
-	display_string(2, bufMax); // min temp
 	display_string(3, "Back to menu");
 	display_update();
 }
 
 void menu(void)
 {
-
-	display_string(0, "Menu:");
-	display_string(1, "Chose unit");
-	display_string(2, "Measur. Type");
-	display_string(3, "Display temperature");
-	display_update();
+	screen_show(SCREEN_MENU);
 }
 void unit(void)
 {
-
-	display_string(0, "Celcius");
-	display_string(1, "Kelvin");
-	display_string(2, "Farenheit");
-	display_string(3, "Back to Menu");
-	display_update();
+	screen_show(SCREEN_UNIT);
 	quicksleep(100);
 	while (getbtns() != 0)
 	{
@@ -864,33 +380,21 @@ void unit(void)
 			celcius = 1;
 			farenheit = 0;
 			kelvin = 0;
-			display_string(0, "Celcius selected");
-			display_string(1, "Kelvin");
-			display_string(2, "Farenheit");
-			display_string(3, "Back to Menu");
-			display_update();
+			screen_select(SCREEN_UNIT, 0, "Celcius selected");
 		}
 		if (getbtns() & 2) // button 3. Select Kelvin
 		{
 			celcius = 0;
 			farenheit = 0;
 			kelvin = 1;
-			display_string(0, "Celcius");
-			display_string(1, "Kelvin selected");
-			display_string(2, "Farenheit");
-			display_string(3, "Back to Menu");
-			display_update();
+			screen_select(SCREEN_UNIT, 1, "Kelvin selected");
 		}
 		if (getbtns() & 1) // button 2. select Farenheit
 		{
 			celcius = 0;
 			kelvin = 0;
 			farenheit = 1;
-			display_string(0, "Celcius");
-			display_string(1, "Kelvin");
-			display_string(2, "Farenheit selected");
-			display_string(3, "Back to Menu");
-			display_update();
+			screen_select(SCREEN_UNIT, 2, "Farenheit selected");
 		}
 		if (getbtn1() & 0x200 && units == 1) // button 1 exit
 		{
@@ -904,11 +408,7 @@ void unit(void)
 void measurementType(void)
 {
 	// update the display
-	display_string(0, "Set timer");
-	display_string(1, "Continuous");
-	display_string(2, "Average func.");
-	display_string(3, "Back to Menu");
-	display_update();
+	screen_show(SCREEN_TYPE);
 	quicksleep(100);
 	while (getbtns() != 0) // is needed whenever i enter a sub menu to make sure the buttons
 	// are released
@@ -926,17 +426,13 @@ void measurementType(void)
 		{
 			average = 1;
 			continuous = 0;
-			display_string(1, "Continuous");
-			display_string(2, "Average selected");
-			display_update();
+			screen_select(SCREEN_TYPE, 2, "Average selected");
 		}
 		else if (getbtns() & 2 && type == 1) // button 3. select continus measurment
 		{
 			average = 0;
 			continuous = 1;
-			display_string(1, "Cont. selected");
-			display_string(2, "Average func.");
-			display_update();
+			screen_select(SCREEN_TYPE, 1, "Cont. selected");
 		}
 		else if (getbtns() & 4 && type == 1)
 		{
@@ -948,25 +444,21 @@ void measurementType(void)
 }
 void setTime(void)
 {
-	display_string(1, "");
-	display_string(2, "");
-	display_update();
-	// print the current set timer
-	float t = (float)timer;
-	char d[32];
-	ftoa(t, d, 0);
-	display_string(2, d);
+	// print the current set timer over the timer screen
+	screen_show(SCREEN_TIMER);
+	display_printf(2, "%d s", timer);
 	display_update();
 	quicksleep(100);
 	while (getbtns() != 0)
 	{
 	}
+	int back = getsw() & 0x2; // switch 1 is the sensor's alert line, see mipslabi2c.c
 	while (setTimePage == 1)
 	{
 		while (getbtns() != 0 | getbtn1() != 0)
 		{
 		}
-		if (getsw() & 0x1) // go back if you flip switch 1 up
+		if ((getsw() & 0x2) != back) // go back if you flip switch 2 either way
 		{
 			type = 1;
 			setTimePage = 0;
@@ -976,37 +468,25 @@ void setTime(void)
 		else if (getbtn1() & 0x200)
 		{ // pressing button 1 adds 1 to timer
 			timer++;
-			float t = (float)timer;
-			char d[32];
-			ftoa(t, d, 0);
-			display_string(2, d);
+			display_printf(2, "%d s", timer);
 			display_update();
 		}
 		else if (getbtns() & 1)
 		{ // pressing button 2 adds 10 to the timer
 			timer += 10;
-			float t = (float)timer;
-			char d[32];
-			ftoa(t, d, 0);
-			display_string(2, d);
+			display_printf(2, "%d s", timer);
 			display_update();
 		}
 		else if (getbtns() & 2)
 		{ // pressing button 3 adds 100 to the timer
 			timer += 100;
-			float t = (float)timer;
-			char d[32];
-			ftoa(t, d, 0);
-			display_string(2, d);
+			display_printf(2, "%d s", timer);
 			display_update();
 		}
 		else if (getbtns() & 4)
 		{ // pressing button 4 adds 1000 to the timer
 			timer += 1000;
-			float t = (float)timer;
-			char d[32];
-			ftoa(t, d, 0);
-			display_string(2, d);
+			display_printf(2, "%d s", timer);
 			display_update();
 		}
 		if (timer >= 2000)
@@ -1016,6 +496,39 @@ void setTime(void)
 	}
 }
 
+/* Boot with switch 4 up to compare the display transfer paths.
+   Shows bytes per second for per-byte and burst sends */
+void showBenchmark(void)
+{
+	unsigned int byteRate, burstRate, readRate;
+
+	display_benchmark(&byteRate, &burstRate);
+	display_string(0, "SPI bytes/s");
+	display_printf(1, "byte  %u", byteRate);
+	display_printf(2, "burst %u", burstRate);
+	display_string(3, "Next");
+	display_update();
+
+	while (!(getbtn1() & 0x200))
+	{
+	}
+	while (getbtn1() != 0)
+	{
+	}
+
+	// I2C reads of the sensor, with the pointer written every time
+	i2c_benchmark(&readRate, &byteRate);
+	display_printf(0, "I2C %u kHz", I2C1_HZ / 1000);
+	display_printf(1, "%u reads/s", readRate);
+	display_printf(2, "%u bytes/s", byteRate);
+	display_string(3, "Back to menu");
+	display_update();
+
+	while (!(getbtn1() & 0x200))
+	{
+	}
+}
+
 void showTemperature(void)
 {
 	if (continuous == 1)
@@ -1040,30 +553,14 @@ void showTemperature(void)
 	{
 		// check which temperature string we should display
 		// temperature will be displayed on line 1.
-		if (celcius == 1 && average == 1)
-		{
-
-			celciusAverage(timer);
-		}
-		else if (celcius == 1 && continuous == 1)
-		{
-			getCelciusTemperature();
-		}
-		else if (kelvin == 1 && continuous == 1)
-		{
-			getKelvinTemperature();
-		}
-		else if (kelvin == 1 && average == 1)
-		{
-			kelvinAverage(timer);
-		}
-		else if (farenheit == 1 && continuous == 1)
+		// in whichever unit is selected, see unitSuffix and toUnit
+		if (average == 1)
 		{
-			getFarenheitTemperature();
+			showAverage(timer);
 		}
-		else if (farenheit == 1 && average == 1)
+		else if (continuous == 1)
 		{
-			fahrenheitAverage(timer);
+			getTemperature();
 		}
 		if (getbtn1() & 0x200)
 		{
@@ -1105,10 +602,14 @@ void temperatureLoop(void)
 	}
 }
 
+/* How long the splash stays up after the first reading is on it */
+#define SPLASH_MS 1000
+
 int main(void)
 {
 	uint16_t temp;
-	char buf[32], *s, *t;
+	unsigned int bootStart = core_timer(); // for the time to first reading
+	unsigned int bootMs;
 	/*
   This will set the peripheral bus clock to the same frequency
   as the sysclock. That means 80 MHz, when the microcontroller
@@ -1144,6 +645,10 @@ int main(void)
 	/* Set up SPI as master */
 	SPI2CON = 0;
 	SPI2BRG = 4;
+	/* SPI2CON bit ENHBUF = 1; 16-byte FIFOs for burst transfers */
+	SPI2CONSET = 1 << 16;
+	/* SPI2CON bits STXISEL = 01; TX interrupt when the FIFO is empty */
+	SPI2CONSET = 0x4;
 	/* SPI2STAT bit SPIROV = 0; */
 	SPI2STATCLR = 0x40;
 	/* SPI2CON bit CKP = 1; */
@@ -1153,33 +658,65 @@ int main(void)
 	/* SPI2CON bit ON = 1; */
 	SPI2CONSET = 0x8000;
 
-	/* Set up i2c */
-	I2C1CON = 0x0;
-	/* I2C Baud rate should be less than 400 kHz, is generated by dividing
-	the 40 MHz peripheral bus clock down */
-	I2C1BRG = 0x0C2;
-	I2C1STAT = 0x0;
-	I2C1CONSET = 1 << 13; // SIDL = 1
-	I2C1CONSET = 1 << 15; // ON = 1
-	temp = I2C1RCV;		  // Clear receive buffer
+	/* Start powering up the display. It needs over 100 ms for its supplies to
+	settle, and the I2C and sensor set-up below runs in that time: each stage
+	is followed by a display_init_poll, so the next power-up step starts as
+	soon as it is due. */
+	display_init_start();
+
+	/* Set up i2c as master; transfers run from its interrupt, and are
+	polled through until interrupts are enabled below */
+	i2c_init();
+	display_init_poll();
+
+	/* Find the sensors on the bus; the main one at TEMP_SENSOR_ADDR is
+	channel 0 when it is there */
+	sensorCount = temp_scan(SENSOR_BITS);
+	display_init_poll();
+	sensorStart(SENSOR_BOOT_BITS, 0); /* the first reading is taken while the display powers up */
+	display_init_poll();
+	/* In comparator mode, so the alert and the LEDs follow the temperature */
+	while (!temp_alert_set(ALERT_LIMIT * 256, ALERT_HYST * 256, 0))
+	{
+		i2c_service(); // the sensor's mode is still on its way
+	}
+	display_init_poll();
+	init();		   /* Do any requiered initialization */
+
+	while (!display_init_poll())
+	{
+		i2c_service(); // interrupts are still off, so move the sensor batch on here
+	}
 
-	// Introduction display
-	display_init();
+	// Introduction display, with the first reading and how long it took
+	temp = sensorWait();
+	bootMs = (core_timer() - bootStart) / (CORE_TIMER_HZ / 1000);
 	display_string(0, "KTH/ICT ");
 	display_string(1, "Project");
 	display_string(2, "Group 38");
-	display_string(3, "Temp. Sensor");
+	if (sensorError == 0)
+	{
+		display_printf(3, "%.1f\xB0" "C %u ms", convertInt16(temp), bootMs);
+	}
+	else
+	{
+		display_printf(3, "No sensor %u ms", bootMs);
+	}
 	display_update();
 
 	/* Black screen before menu pops up */
-	quicksleep(10000000);
+	delay_us(SPLASH_MS * 1000);
 	display_string(0, "");
 	display_string(1, "");
 	display_string(2, "");
 	display_string(3, "");
 	display_update();
 
-	init(); /* Do any requiered initialization */
+	enable_interrupt();
+	if (getsw() & 0x8)
+	{
+		showBenchmark();
+	}
 	menu();
 
 	while (1)
@@ -0,0 +1,339 @@
+/* mkassets.c
+   Host tool that turns the sources in assets/ into mipslabassets.c:
+   the font from font.pbm, the splash from splash.pbm, and the menu
+   screens in screens.def rendered with that font. Run it from the
+   Project directory, through make assets, with the files to take
+   the character set from as arguments.
+
+   Bitmaps are stored page by page like display RAM, packed in the
+   run-length format display_unpack reads. Only the glyphs for
+   characters that appear in a string or character literal in one of
+   the argument files are kept, behind a 256-entry index.
+
+   For copyright and licensing, see file COPYING */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+static const char *const screen_lines[][4] = {
+#define SCREEN(id, l0, l1, l2, l3) {l0, l1, l2, l3},
+#include "../assets/screens.def"
+#undef SCREEN
+};
+
+static const char *const screen_names[] = {
+#define SCREEN(id, l0, l1, l2, l3) #id,
+#include "../assets/screens.def"
+#undef SCREEN
+};
+
+#define SCREEN_COUNT (int)(sizeof(screen_names) / sizeof(screen_names[0]))
+
+/* The font as 8 column bytes per character, ISO 8859-1 */
+static uint8_t font[256 * 8];
+
+/* Characters the firmware can show */
+static char used[256];
+
+static void fail(const char *name, const char *what)
+{
+  fprintf(stderr, "mkassets: %s: %s\n", name, what);
+  exit(1);
+}
+
+/* Skip white space and comments in a PBM, return the next character */
+static int pbm_skip(FILE *f)
+{
+  int c;
+
+  while ((c = getc(f)) != EOF)
+  {
+    if (c == '#')
+      while ((c = getc(f)) != EOF && c != '\n')
+        ;
+    else if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+      break;
+  }
+  return c;
+}
+
+/* Read a plain (P1) PBM of exactly w by h pixels into page-ordered
+   bytes, bit 0 the top row of each page */
+static void pbm_read(const char *name, int w, int h, uint8_t *out)
+{
+  FILE *f = fopen(name, "r");
+  int fw, fh, x, y, c;
+
+  if (!f)
+    fail(name, "cannot open");
+  if (getc(f) != 'P' || getc(f) != '1')
+    fail(name, "not a plain PBM");
+  ungetc(pbm_skip(f), f);
+  if (fscanf(f, "%d", &fw) != 1)
+    fail(name, "bad header");
+  ungetc(pbm_skip(f), f);
+  if (fscanf(f, "%d", &fh) != 1)
+    fail(name, "bad header");
+  if (fw != w || fh != h)
+    fail(name, "wrong size");
+
+  for (x = 0; x < w * h / 8; x++)
+    out[x] = 0;
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++)
+    {
+      c = pbm_skip(f);
+      if (c != '0' && c != '1')
+        fail(name, "bad pixel data");
+      if (c == '1')
+        out[(y / 8) * w + x] |= 1 << (y % 8);
+    }
+  fclose(f);
+}
+
+/* Mark the characters of the C escape sequence at s, after the
+   backslash, as used. Returns the first character after it. */
+static const char *scan_escape(const char *s)
+{
+  int c = 0, n;
+
+  switch (*s)
+  {
+  case 'x':
+    for (s++; isxdigit((unsigned char)*s); s++)
+      c = c * 16 + (isdigit((unsigned char)*s) ? *s - '0' : tolower((unsigned char)*s) - 'a' + 10);
+    break;
+  case '0': case '1': case '2': case '3':
+  case '4': case '5': case '6': case '7':
+    for (n = 0; n < 3 && *s >= '0' && *s <= '7'; n++, s++)
+      c = c * 8 + *s - '0';
+    break;
+  default:
+    c = *s++;
+    break;
+  }
+  used[c & 0xFF] = 1;
+  return s;
+}
+
+/* Skip a display_printf conversion such as %-5.1f, after the '%'.
+   What it prints is covered by charset.def. */
+static const char *scan_conversion(const char *s)
+{
+  while (*s == '-' || *s == '.' || (*s >= '0' && *s <= '9'))
+    s++;
+  return *s ? s + 1 : s;
+}
+
+/* Mark every character in the string and character literals of a
+   source file as used. Comments, preprocessor lines and printf-style
+   conversions are skipped: the strings of #include and #error never
+   reach the display. */
+static void scan_file(const char *name)
+{
+  FILE *f = fopen(name, "r");
+  static char text[256 * 1024];
+  const char *s;
+  char quote;
+  size_t n;
+
+  if (!f)
+    fail(name, "cannot open");
+  n = fread(text, 1, sizeof(text) - 1, f);
+  fclose(f);
+  text[n] = 0;
+
+  for (s = text; *s;)
+  {
+    if (s[0] == '/' && s[1] == '*')
+    {
+      for (s += 2; *s && !(s[0] == '*' && s[1] == '/'); s++)
+        ;
+      if (*s)
+        s += 2;
+    }
+    else if (s[0] == '/' && s[1] == '/')
+      while (*s && *s != '\n')
+        s++;
+    else if (*s == '#')
+    {
+      /* To the end of the line, and of any lines it continues on */
+      for (; *s && *s != '\n'; s++)
+        if (s[0] == '\\' && s[1] == '\n')
+          s++;
+    }
+    else if (*s == '"' || *s == '\'')
+    {
+      for (quote = *s++; *s && *s != quote && *s != '\n';)
+        if (*s == '\\')
+          s = scan_escape(s + 1);
+        else if (*s == '%' && quote == '"' && s[1] != '%')
+          s = scan_conversion(s + 1);
+        else
+          used[(unsigned char)*s++] = 1;
+      if (*s == quote)
+        s++;
+    }
+    else
+      s++;
+  }
+}
+
+/* Print n bytes as the body of a C array */
+static void print_bytes(const uint8_t *p, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    printf("%s%d,%s", i % 16 ? " " : "  ", p[i],
+           i % 16 == 15 || i == n - 1 ? "\n" : "");
+}
+
+/* Pack n bytes. A control byte c below 128 is followed by c + 1
+   bytes to copy; from 128 up it is followed by one byte to repeat
+   c - 126 times. Returns the packed length. */
+static int pack_rle(const uint8_t *in, int n, uint8_t *out)
+{
+  int i = 0, o = 0, run, lit;
+
+  while (i < n)
+  {
+    for (run = 1; i + run < n && run < 129 && in[i + run] == in[i]; run++)
+      ;
+    if (run >= 2)
+    {
+      out[o++] = run + 126;
+      out[o++] = in[i];
+      i += run;
+      continue;
+    }
+    /* Copy up to where the next run starts */
+    for (lit = 1; i + lit < n && lit < 128; lit++)
+      if (i + lit + 1 < n && in[i + lit] == in[i + lit + 1])
+        break;
+    out[o++] = lit - 1;
+    while (lit--)
+      out[o++] = in[i++];
+  }
+  return o;
+}
+
+/* Print a packed bitmap as an array called name, with storage
+   class static when it is only reached through a table */
+static int print_packed(const char *storage, const char *name, const uint8_t *in, int n)
+{
+  uint8_t out[2 * 512];
+  int len = pack_rle(in, n, out);
+
+  printf("/* %d bytes, packed from %d */\n", len, n);
+  printf("%sconst uint8_t %s[] = {\n", storage, name);
+  print_bytes(out, len);
+  printf("};\n\n");
+  return len;
+}
+
+/* The glyphs of the used characters, 8 columns each, and an index
+   from character to glyph. Glyph 0 is blank, and every character
+   with a blank glyph or that is not used maps to it. */
+static void print_font(void)
+{
+  int map[256];
+  int n = 1, c, k, blank;
+
+  printf("const uint8_t font_glyphs[][8] __attribute__((aligned(4))) = {\n");
+  printf("  {0, 0, 0, 0, 0, 0, 0, 0},\n");
+  for (c = 0; c < 256; c++)
+  {
+    map[c] = 0;
+    if (!used[c] || c < ' ')
+      continue;
+    for (blank = 1, k = 0; k < 8; k++)
+      if (font[c * 8 + k])
+        blank = 0;
+    if (blank)
+    {
+      if (c != ' ')
+        fprintf(stderr, "mkassets: no glyph for character 0x%02X\n", c);
+      continue;
+    }
+    map[c] = n++;
+    printf("  {");
+    for (k = 0; k < 8; k++)
+      printf("%d%s", font[c * 8 + k], k < 7 ? ", " : "");
+    if (c < 128)
+      printf("}, /* %c */\n", c);
+    else
+      printf("}, /* 0x%02X */\n", c);
+  }
+  printf("};\n\n");
+
+  printf("/* %d glyphs and the index, %d bytes */\n", n, n * 8 + 256);
+  printf("const uint8_t font_map[256] = {\n");
+  for (c = 0; c < 256; c++)
+    printf("%s%d,%s", c % 16 ? " " : "  ", map[c], c % 16 == 15 ? "\n" : "");
+  printf("};\n\n");
+}
+
+/* Render a screen the way display_render_text would draw it */
+static void render_screen(const char *const lines[4], uint8_t *image)
+{
+  const char *s;
+  int i, j, k, c;
+
+  for (i = 0; i < 4; i++)
+  {
+    s = lines[i];
+    for (j = 0; j < 16; j++)
+    {
+      c = *s ? (unsigned char)*s++ : ' ';
+      for (k = 0; k < 8; k++)
+        image[i * 128 + j * 8 + k] = font[c * 8 + k];
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint8_t sheet[16 * 128], image[512];
+  char name[32];
+  int c, k, n, total;
+
+  for (n = 1; n < argc; n++)
+    scan_file(argv[n]);
+
+  /* Glyph c is at column (c % 16) * 8 of page c / 16 of the sheet */
+  pbm_read("assets/font.pbm", 128, 128, sheet);
+  for (c = 0; c < 256; c++)
+    for (k = 0; k < 8; k++)
+      font[c * 8 + k] = sheet[(c / 16) * 128 + (c % 16) * 8 + k];
+
+  printf("/* mipslabassets.c\n"
+         "   Generated by tools/mkassets from the files in assets/.\n"
+         "   Do not edit, run make assets instead.\n\n"
+         "   For copyright and licensing, see file COPYING */\n\n"
+         "#include <stdint.h>  /* Declarations of uint_32 and the like */\n"
+         "#include <pic32mx.h> /* Declarations of system-specific addresses etc */\n"
+         "#include \"mipslab.h\" /* Declatations for these labs */\n\n");
+
+  print_font();
+
+  pbm_read("assets/splash.pbm", 128, 32, image);
+  print_packed("", "splash_image", image, 512);
+
+  total = 0;
+  for (n = 0; n < SCREEN_COUNT; n++)
+  {
+    render_screen(screen_lines[n], image);
+    sprintf(name, "screen%d", n);
+    total += print_packed("static ", name, image, 512);
+  }
+  printf("/* %d screens in %d bytes */\n", SCREEN_COUNT, total);
+  printf("const uint8_t *const screen_images[SCREEN_COUNT] = {\n");
+  for (n = 0; n < SCREEN_COUNT; n++)
+    printf("  screen%d, /* %s */\n", n, screen_names[n]);
+  printf("};\n");
+  return 0;
+}